@@ -0,0 +1,455 @@
+/* qoi - encoder and decoder for the "Quite OK Image" format - public domain
+                                  no warranty implied; use at your own risk
+
+   Do this:
+      #define QOI_IMPLEMENTATION
+   before you include this file in *one* C or C++ file to create the implementation.
+
+   #define QOI_MALLOC and QOI_FREE to avoid using malloc and free, and
+   QOI_NO_STDIO to remove qoi_read and qoi_write.
+
+
+   QUICK NOTES:
+      QOI losslessly compresses 8 bit rgb and rgba images into sizes close to
+      PNG's, and decodes them several times faster, in a single pass without
+      any entropy coding. Pixels are stored top to bottom.
+
+      Format specification: https://qoiformat.org/qoi-specification.pdf
+
+      A file is a 14 byte header ("qoif", big endian width and height,
+      channels, colorspace), a stream of chunks, and 7 zero bytes followed by
+      a one. Each chunk encodes one or more pixels as
+         - a run of the previous pixel,
+         - an index into the 64 most recently seen pixels (hashed),
+         - a small difference from the previous pixel (DIFF and LUMA),
+         - or the pixel itself (RGB and RGBA).
+
+
+   API:
+      qoi_desc desc = { width, height, channels (3 or 4), QOI_SRGB };
+
+      // returns the encoded file, out_len bytes long, or NULL on failure
+      void *qoi_encode(const void *pixels, const qoi_desc *desc, int *out_len);
+
+      // decodes size bytes of a file into pixels of channels channels (0 for
+      // the file's own), filling desc. Returns NULL on failure
+      void *qoi_decode(const void *data, int size, qoi_desc *desc, int channels);
+
+      // both return memory freed with qoi_free
+      void qoi_free(void *data);
+
+      // the same, to and from files. qoi_write returns the bytes written, 0 on failure
+      int qoi_write(const char *filename, const void *pixels, const qoi_desc *desc);
+      void *qoi_read(const char *filename, qoi_desc *desc, int channels);
+*/
+
+#ifndef QOI_H
+#define QOI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QOI_SRGB   0
+#define QOI_LINEAR 1
+
+typedef struct
+{
+   unsigned int width;
+   unsigned int height;
+   unsigned char channels;
+   unsigned char colorspace;
+} qoi_desc;
+
+#define QOI_MAGIC_BYTES "qoif"
+#define QOI_HEADER_SIZE 14
+// images larger than this are refused, so sizes never overflow an int
+#define QOI_PIXELS_MAX 400000000u
+
+void *qoi_encode(const void *pixels, const qoi_desc *desc, int *out_len);
+void *qoi_decode(const void *data, int size, qoi_desc *desc, int channels);
+void qoi_free(void *data);
+
+#ifndef QOI_NO_STDIO
+int qoi_write(const char *filename, const void *pixels, const qoi_desc *desc);
+void *qoi_read(const char *filename, qoi_desc *desc, int channels);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // QOI_H
+
+
+#ifdef QOI_IMPLEMENTATION
+
+#include <string.h>
+
+#ifndef QOI_MALLOC
+#include <stdlib.h>
+#define QOI_MALLOC(sz) malloc(sz)
+#define QOI_FREE(p) free(p)
+#endif
+
+#ifndef QOI_NO_STDIO
+#include <stdio.h>
+#endif
+
+#define QOI__OP_INDEX 0x00 /* 00xxxxxx */
+#define QOI__OP_DIFF  0x40 /* 01xxxxxx */
+#define QOI__OP_LUMA  0x80 /* 10xxxxxx */
+#define QOI__OP_RUN   0xc0 /* 11xxxxxx */
+#define QOI__OP_RGB   0xfe /* 11111110 */
+#define QOI__OP_RGBA  0xff /* 11111111 */
+
+#define QOI__PADDING_SIZE 8
+
+// pixels are packed into an unsigned int by shifts rather than read through a union of bytes: writing single bytes
+// and reading them back as a word stalls store forwarding on every pixel
+#define QOI__PACK(r, g, b, a) ((unsigned int)(r) | (unsigned int)(g) << 8 | (unsigned int)(b) << 16 | (unsigned int)(a) << 24)
+
+static const unsigned char qoi__padding[QOI__PADDING_SIZE] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+static int qoi__hash(unsigned int r, unsigned int g, unsigned int b, unsigned int a)
+{
+   return (int)((r * 3 + g * 5 + b * 7 + a * 11) & 63);
+}
+
+static void qoi__write_32(unsigned char *bytes, int *p, unsigned int v)
+{
+   bytes[(*p)++] = (unsigned char)(v >> 24);
+   bytes[(*p)++] = (unsigned char)(v >> 16);
+   bytes[(*p)++] = (unsigned char)(v >> 8);
+   bytes[(*p)++] = (unsigned char)v;
+}
+
+static unsigned int qoi__read_32(const unsigned char *bytes, int *p)
+{
+   unsigned int a = bytes[(*p)++];
+   unsigned int b = bytes[(*p)++];
+   unsigned int c = bytes[(*p)++];
+   unsigned int d = bytes[(*p)++];
+   return a << 24 | b << 16 | c << 8 | d;
+}
+
+static int qoi__valid_desc(const qoi_desc *desc)
+{
+   return desc->width && desc->height && (desc->channels == 3 || desc->channels == 4) && desc->colorspace <= 1 &&
+      desc->height < QOI_PIXELS_MAX / desc->width;
+}
+
+void *qoi_encode(const void *pixels, const qoi_desc *desc, int *out_len)
+{
+   const unsigned char *px_bytes = (const unsigned char *)pixels;
+   unsigned char *bytes;
+   unsigned int index[64];
+   unsigned int px, px_prev;
+   unsigned char r, g, b, a;
+   unsigned char r_prev, g_prev, b_prev, a_prev;
+   int max_size, p = 0, run = 0, i;
+   int px_len, px_end, px_pos, channels;
+
+   if (!pixels || !desc || !out_len || !qoi__valid_desc(desc))
+      return NULL;
+
+   // every pixel as RGBA, at worst
+   max_size = (int)(desc->width * desc->height * (desc->channels + 1u)) + QOI_HEADER_SIZE + QOI__PADDING_SIZE;
+
+   bytes = (unsigned char *)QOI_MALLOC(max_size);
+   if (!bytes)
+      return NULL;
+
+   memcpy(bytes, QOI_MAGIC_BYTES, 4);
+   p = 4;
+   qoi__write_32(bytes, &p, desc->width);
+   qoi__write_32(bytes, &p, desc->height);
+   bytes[p++] = desc->channels;
+   bytes[p++] = desc->colorspace;
+
+   memset(index, 0, sizeof(index));
+
+   r_prev = g_prev = b_prev = 0;
+   a = a_prev = 255;
+   px_prev = QOI__PACK(0, 0, 0, 255);
+
+   channels = desc->channels;
+   px_len = (int)(desc->width * desc->height) * channels;
+   px_end = px_len - channels;
+
+   for (px_pos = 0; px_pos < px_len; px_pos += channels)
+   {
+      r = px_bytes[px_pos];
+      g = px_bytes[px_pos + 1];
+      b = px_bytes[px_pos + 2];
+      if (channels == 4)
+         a = px_bytes[px_pos + 3];
+
+      px = QOI__PACK(r, g, b, a);
+
+      if (px == px_prev)
+      {
+         ++run;
+         if (run == 62 || px_pos == px_end)
+         {
+            bytes[p++] = (unsigned char)(QOI__OP_RUN | (run - 1));
+            run = 0;
+         }
+         continue;
+      }
+
+      if (run > 0)
+      {
+         bytes[p++] = (unsigned char)(QOI__OP_RUN | (run - 1));
+         run = 0;
+      }
+
+      i = qoi__hash(r, g, b, a);
+
+      if (index[i] == px)
+         bytes[p++] = (unsigned char)(QOI__OP_INDEX | i);
+      else
+      {
+         index[i] = px;
+
+         if (a == a_prev)
+         {
+            // differences wrap around, like the decoder's sums
+            signed char vr = (signed char)(r - r_prev);
+            signed char vg = (signed char)(g - g_prev);
+            signed char vb = (signed char)(b - b_prev);
+            signed char vg_r = (signed char)(vr - vg);
+            signed char vg_b = (signed char)(vb - vg);
+
+            if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+               bytes[p++] = (unsigned char)(QOI__OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+            else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+            {
+               bytes[p++] = (unsigned char)(QOI__OP_LUMA | (vg + 32));
+               bytes[p++] = (unsigned char)((vg_r + 8) << 4 | (vg_b + 8));
+            }
+            else
+            {
+               bytes[p++] = QOI__OP_RGB;
+               bytes[p++] = r;
+               bytes[p++] = g;
+               bytes[p++] = b;
+            }
+         }
+         else
+         {
+            bytes[p++] = QOI__OP_RGBA;
+            bytes[p++] = r;
+            bytes[p++] = g;
+            bytes[p++] = b;
+            bytes[p++] = a;
+         }
+      }
+
+      px_prev = px;
+      r_prev = r;
+      g_prev = g;
+      b_prev = b;
+      a_prev = a;
+   }
+
+   memcpy(bytes + p, qoi__padding, QOI__PADDING_SIZE);
+   p += QOI__PADDING_SIZE;
+
+   *out_len = p;
+   return bytes;
+}
+
+// decodes the chunks into count pixels. Only called with a constant channels, so each gets its own loop once inlined
+static void qoi__decode_chunks(const unsigned char *bytes, int p, int chunks_len, unsigned char *out, int count, int channels)
+{
+   unsigned int index[64];
+   unsigned int r = 0, g = 0, b = 0, a = 255;
+   unsigned char *end = out + (size_t)count * channels;
+
+   memset(index, 0, sizeof(index));
+
+   while (out < end)
+   {
+      int run = 0;
+
+      // a truncated file fills the rest of the image with the last pixel
+      if (p < chunks_len)
+      {
+         unsigned int b1 = bytes[p++];
+
+         if (b1 < QOI__OP_DIFF)
+         {
+            unsigned int v = index[b1];
+            r = v & 0xff;
+            g = (v >> 8) & 0xff;
+            b = (v >> 16) & 0xff;
+            a = v >> 24;
+         }
+         else if (b1 < QOI__OP_LUMA)
+         {
+            r = (r + ((b1 >> 4) & 3) - 2) & 0xff;
+            g = (g + ((b1 >> 2) & 3) - 2) & 0xff;
+            b = (b + (b1 & 3) - 2) & 0xff;
+         }
+         else if (b1 < QOI__OP_RUN)
+         {
+            unsigned int b2 = bytes[p++];
+            unsigned int vg = (b1 & 0x3f) - 32;
+            r = (r + vg - 8 + (b2 >> 4)) & 0xff;
+            g = (g + vg) & 0xff;
+            b = (b + vg - 8 + (b2 & 0x0f)) & 0xff;
+         }
+         else if (b1 == QOI__OP_RGB)
+         {
+            r = bytes[p];
+            g = bytes[p + 1];
+            b = bytes[p + 2];
+            p += 3;
+         }
+         else if (b1 == QOI__OP_RGBA)
+         {
+            r = bytes[p];
+            g = bytes[p + 1];
+            b = bytes[p + 2];
+            a = bytes[p + 3];
+            p += 4;
+         }
+         else
+            run = (int)(b1 & 0x3f);
+
+         // runs store their pixel too: the initial pixel of a run that starts the image isn't in the index yet
+         index[qoi__hash(r, g, b, a)] = QOI__PACK(r, g, b, a);
+      }
+      else
+         run = (int)((end - out) / channels) - 1;
+
+      // the pixel, and the run of it that follows
+      do
+      {
+         out[0] = (unsigned char)r;
+         out[1] = (unsigned char)g;
+         out[2] = (unsigned char)b;
+         if (channels == 4)
+            out[3] = (unsigned char)a;
+         out += channels;
+      } while (run-- > 0 && out < end);
+   }
+}
+
+void *qoi_decode(const void *data, int size, qoi_desc *desc, int channels)
+{
+   const unsigned char *bytes = (const unsigned char *)data;
+   unsigned char *pixels;
+   int count, p;
+
+   if (!data || !desc || (channels != 0 && channels != 3 && channels != 4) || size < QOI_HEADER_SIZE + QOI__PADDING_SIZE ||
+      memcmp(bytes, QOI_MAGIC_BYTES, 4))
+      return NULL;
+
+   p = 4;
+   desc->width = qoi__read_32(bytes, &p);
+   desc->height = qoi__read_32(bytes, &p);
+   desc->channels = bytes[p++];
+   desc->colorspace = bytes[p++];
+
+   if (!qoi__valid_desc(desc))
+      return NULL;
+
+   if (channels == 0)
+      channels = desc->channels;
+
+   count = (int)(desc->width * desc->height);
+   pixels = (unsigned char *)QOI_MALLOC((size_t)count * channels);
+   if (!pixels)
+      return NULL;
+
+   // every chunk starts before the padding, and is at most 5 bytes long, so reading one never goes past the end
+   if (channels == 4)
+      qoi__decode_chunks(bytes, p, size - QOI__PADDING_SIZE, pixels, count, 4);
+   else
+      qoi__decode_chunks(bytes, p, size - QOI__PADDING_SIZE, pixels, count, 3);
+
+   return pixels;
+}
+
+void qoi_free(void *data)
+{
+   QOI_FREE(data);
+}
+
+#ifndef QOI_NO_STDIO
+
+int qoi_write(const char *filename, const void *pixels, const qoi_desc *desc)
+{
+   FILE *f;
+   int size, written;
+   void *encoded;
+
+   encoded = qoi_encode(pixels, desc, &size);
+   if (!encoded)
+      return 0;
+
+   f = fopen(filename, "wb");
+   if (!f)
+   {
+      QOI_FREE(encoded);
+      return 0;
+   }
+
+   written = (int)fwrite(encoded, 1, (size_t)size, f);
+   if (fclose(f) || written != size)
+      written = 0;
+
+   QOI_FREE(encoded);
+   return written;
+}
+
+void *qoi_read(const char *filename, qoi_desc *desc, int channels)
+{
+   FILE *f = fopen(filename, "rb");
+   long size;
+   void *data, *pixels;
+
+   if (!f)
+      return NULL;
+
+   if (fseek(f, 0, SEEK_END) || (size = ftell(f)) <= 0 || size > 0x7fffffffL || fseek(f, 0, SEEK_SET))
+   {
+      fclose(f);
+      return NULL;
+   }
+
+   data = QOI_MALLOC((size_t)size);
+   if (!data)
+   {
+      fclose(f);
+      return NULL;
+   }
+
+   if (fread(data, 1, (size_t)size, f) != (size_t)size)
+   {
+      fclose(f);
+      QOI_FREE(data);
+      return NULL;
+   }
+
+   fclose(f);
+
+   pixels = qoi_decode(data, (int)size, desc, channels);
+   QOI_FREE(data);
+   return pixels;
+}
+
+#endif // QOI_NO_STDIO
+
+#endif // QOI_IMPLEMENTATION
+
+/*
+------------------------------------------------------------------------------
+This software is available under the public domain (www.unlicense.org).
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+------------------------------------------------------------------------------
+*/
@@ -37,6 +37,7 @@ public:
 	{
 		destroy();
 		glGenVertexArrays(1, &id);
+		residency_manager::get().track(resource_category::vertex_array, id, 0);
 	}
 
 	inline void use() const
@@ -46,6 +47,9 @@ public:
 
 	inline void destroy()
 	{
+		// 0 was never tracked
+		if (id)
+			residency_manager::get().untrack(resource_category::vertex_array, id);
 		glDeleteVertexArrays(1, &id);
 		id = 0;
 	}
@@ -129,6 +133,7 @@ public:
 		detail::context_lock<detail::binding<target>> lock;
 		use();
 		glBufferData(t, data.size() * sizeof(typename C::value_type), &data[0], usage);
+		residency_manager::get().track(resource_category::buffer, id, data.size() * sizeof(typename C::value_type));
 	}
 	template <typename C>
 	inline void attach_data(GLsizeiptr byte_size, const C *data, GLenum usage = GL_STATIC_DRAW) const
@@ -136,6 +141,7 @@ public:
 		detail::context_lock<detail::binding<target>> lock;
 		use();
 		glBufferData(t, byte_size, data, usage);
+		residency_manager::get().track(resource_category::buffer, id, static_cast<std::size_t>(byte_size));
 	}
 	template <typename T, GLsizeiptr N>
 	inline void attach_data(T(&data)[N], GLenum usage = GL_STATIC_DRAW) const
@@ -143,6 +149,7 @@ public:
 		detail::context_lock<detail::binding<target>> lock;
 		use();
 		glBufferData(t, sizeof(data), data, usage);
+		residency_manager::get().track(resource_category::buffer, id, sizeof(data));
 	}
 
 	inline void reserve_data(GLsizeiptr byte_size, GLenum usage = GL_STATIC_DRAW) const
@@ -150,6 +157,7 @@ public:
 		detail::context_lock<detail::binding<target>> lock;
 		use();
 		glBufferData(t, byte_size, nullptr, usage);
+		residency_manager::get().track(resource_category::buffer, id, static_cast<std::size_t>(byte_size));
 	}
 
 	template <typename T>
@@ -260,6 +268,8 @@ public:
 		detail::rbo_lock lock;
 		use();
 		glRenderbufferStorage(target, format, width, height);
+		// 4 bytes per pixel covers the usual color and depth stencil formats
+		residency_manager::get().track(resource_category::buffer, id, static_cast<std::size_t>(width) * height * 4);
 	}
 
 	inline static void quit()
@@ -369,6 +379,8 @@ public:
 
 	inline void destroy()
 	{
+		if (id.id)
+			residency_manager::get().untrack(resource_category::buffer, id.id);
 		glDeleteBuffers(1, &id.id);
 		id.id = 0;
 	}
@@ -472,6 +484,8 @@ public:
 
 	inline void destroy()
 	{
+		if (id.id)
+			residency_manager::get().untrack(resource_category::buffer, id.id);
 		glDeleteRenderbuffers(1, &id.id);
 		id.id = 0;
 	}
@@ -0,0 +1,118 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include "macro.h"
+#include "math/vec.h"
+#include "graphics/texture.h"
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+SGUI_BEG
+
+struct glyph_cache_stats
+{
+	// bytes of texture memory held by atlas pages
+	std::size_t bytes;
+	std::size_t pages;
+	// glyphs currently resident in an atlas
+	std::size_t glyphs;
+
+	// glyphs uploaded to an atlas, including ones re-rasterized after an eviction
+	std::size_t rasterizations;
+	std::size_t evicted_pages;
+	std::size_t evicted_glyphs;
+};
+
+DETAIL_BEG
+
+struct atlas_page;
+
+// where a glyph's bitmap lives in an atlas. page is null when the glyph isn't resident
+struct atlas_slot
+{
+	atlas_page *page;
+	ivec2 pos;
+};
+
+struct atlas_page
+{
+	struct shelf
+	{
+		int y;
+		int height;
+		int x;
+	};
+
+	texture text;
+	int dim;
+
+	std::vector<shelf> shelves;
+	// slots pointing into this page, cleared when the page is evicted
+	std::vector<atlas_slot *> slots;
+
+	class glyph_atlas *owner;
+	uint64_t last_used;
+
+	std::size_t bytes() const { return static_cast<std::size_t>(dim) * dim; }
+};
+
+// single channel texture pages that glyph bitmaps are packed into
+// pages are evicted least recently used first once the atlas' budget, or the budget shared by every atlas, is exceeded.
+// Evicted glyphs have their slot cleared, and are rasterized again the next time they're drawn
+// only use from the thread that owns the OpenGL context
+class glyph_atlas
+{
+public:
+	// page size is picked from the height of the glyphs
+	glyph_atlas(unsigned int glyph_height);
+	~glyph_atlas();
+
+	glyph_atlas(const glyph_atlas &) = delete;
+	glyph_atlas &operator=(const glyph_atlas &) = delete;
+
+	// drops every page. Slots pointing into the atlas aren't cleared, so drop them as well
+	void clear();
+
+	// copies a width x height single channel bitmap (rows top to bottom, pitch bytes apart) into the atlas, and points slot at it
+	void insert(atlas_slot &slot, const unsigned char *pixels, int width, int height, int pitch);
+
+	// marks the page as used by the current batch. Pages used by the current batch are never evicted
+	static void touch(atlas_page *page) { page->last_used = current_batch(); }
+
+	// starts a new batch, call before collecting glyphs for a draw
+	static void begin_batch();
+	static uint64_t current_batch();
+
+	// 0 means no limit other than the global budget
+	void set_budget(std::size_t bytes) { M_budget = bytes; }
+	std::size_t get_budget() const { return M_budget; }
+	const glyph_cache_stats &stats() const { return M_stats; }
+
+	static void set_global_budget(std::size_t bytes);
+	static std::size_t get_global_budget();
+	static const glyph_cache_stats &global_stats();
+
+	static constexpr int padding = 1;
+
+private:
+	std::vector<std::unique_ptr<atlas_page>> M_pages;
+	std::size_t M_budget;
+	int M_page_dim;
+	glyph_cache_stats M_stats;
+
+	atlas_page *allocate(int width, int height, ivec2 &pos);
+	atlas_page *new_page(int dim);
+	bool fit(atlas_page &page, int width, int height, ivec2 &pos) const;
+
+	// evicts pages until bytes more fit in the budgets. Pages used by the current batch are kept, even if that means going over budget
+	void make_room(std::size_t bytes);
+	static void evict(atlas_page *page);
+};
+
+DETAIL_END
+
+SGUI_END
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PIXELS_H
+#define PIXELS_H
+
+#include "macro.h"
+
+#include <cstddef>
+
+SGUI_BEG
+
+DETAIL_BEG
+
+// reverses the order of rows rows of row_bytes bytes each, in place
+void flip_rows(void *data, std::size_t row_bytes, std::size_t rows);
+
+// copies rows rows of row_bytes bytes each from src to dst in reverse order, src and dst can't overlap
+void copy_rows_flipped(void *dst, const void *src, std::size_t row_bytes, std::size_t rows);
+
+// conversions of count 8 bit pixels into rgba. dst and src can't overlap, except where noted
+// every kernel gives the same result whatever instruction set it runs on
+void gray_to_rgba(unsigned char *dst, const unsigned char *src, std::size_t count);
+void gray_alpha_to_rgba(unsigned char *dst, const unsigned char *src, std::size_t count);
+void rgb_to_rgba(unsigned char *dst, const unsigned char *src, std::size_t count);
+// bgra to rgba and back, dst can be src
+void swap_red_blue(unsigned char *dst, const unsigned char *src, std::size_t count);
+
+// multiplies the color of rgba pixels by their alpha, rounded to nearest. dst can be src
+void premultiply_alpha(unsigned char *dst, const unsigned char *src, std::size_t count);
+// divides the color of premultiplied rgba pixels by their alpha, rounded to nearest. Transparent pixels become transparent black. dst can be src
+void unpremultiply_alpha(unsigned char *dst, const unsigned char *src, std::size_t count);
+
+// instruction sets the kernels above can run on. The best one the cpu supports is picked on first use
+enum class simd_level
+{
+	scalar,
+	sse2,
+	avx2,
+	neon
+};
+
+simd_level get_simd_level();
+// forces the kernels down to level (ex. to compare them), levels the cpu doesn't support fall back to the best one it does
+void set_simd_level(simd_level level);
+
+DETAIL_END
+
+SGUI_END
+
+#endif
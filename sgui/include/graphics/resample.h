@@ -0,0 +1,43 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include "macro.h"
+
+#include <vector>
+
+SGUI_BEG
+
+class thread_pool;
+
+// filters images are scaled with
+enum class resample_filter
+{
+	// averages the pixels each pixel covers
+	box,
+	// windowed sinc over 3 lobes, sharper than box, at the cost of some ringing around hard edges
+	lanczos3
+};
+
+// scales an image of 8 bit pixels with 1 to 4 channels (the layouts texture::load takes, rows tightly packed) from src_width x src_height to dst_width x dst_height
+// made for shrinking (thumbnails, mip levels), enlarging works too. The filters are symmetric, so rows can go either way, the result keeps their order.
+// With a pool, the rows of the result are spread over its workers and the calling thread. Every instruction set gives the same result.
+// returns false, and logs an error, if a size is 0 or channels isn't 1 to 4
+bool resample_image(const unsigned char *src, int src_width, int src_height, unsigned char *dst, int dst_width, int dst_height, int channels,
+	resample_filter filter, thread_pool *pool = nullptr);
+
+struct mip_level
+{
+	int width;
+	int height;
+	std::vector<unsigned char> pixels;
+};
+
+// the mip chain of an image in the same layouts as resample_image, without the image itself: levels 1 and up, down to 1x1 or max_levels of them (0 for all).
+// Each level halves the previous one, sizes rounding down like OpenGL's. box averages the 2x2 pixels each pixel covers (repeating the last row or column
+// of 1 pixel wide levels), lanczos3 filters each level from the previous one. Empty, and logs an error, on invalid arguments
+std::vector<mip_level> build_mip_chain(const unsigned char *src, int width, int height, int channels, resample_filter filter = resample_filter::box,
+	thread_pool *pool = nullptr, int max_levels = 0);
+
+SGUI_END
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef RESIDENCY_H
+#define RESIDENCY_H
+
+#include "macro.h"
+
+#include <array>
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+SGUI_BEG
+
+class texture;
+
+enum class resource_category
+{
+	texture,
+	// vertex, index, uniform and pixel buffers, and renderbuffers
+	buffer,
+	// vertex arrays only hold state, so they're counted without any bytes
+	vertex_array,
+	count
+};
+
+struct residency_stats
+{
+	std::size_t bytes;
+	std::size_t resources;
+};
+
+// accounts for the gpu memory held by textures, buffers and vertex arrays, and keeps it under a budget
+// textures made evictable (offscreen images, cached layers...) are evicted least recently used first once the budget is exceeded,
+// and restored the next time a shader binds them, or make_resident is called. Textures used by the current frame are never evicted,
+// even if that means going over budget. Sizes are estimates of what the driver allocates: mip chains are counted, padding isn't
+// only use from the thread that owns the OpenGL context
+class residency_manager
+{
+public:
+	// reallocates the texture and uploads its pixels again, ex. from the file they came from
+	using restore_callback = std::function<void(texture &text)>;
+
+	residency_manager(const residency_manager &) = delete;
+	residency_manager &operator=(const residency_manager &) = delete;
+
+	static residency_manager &get();
+
+	// 0 means no limit, the default
+	void set_budget(std::size_t bytes);
+	std::size_t get_budget() const { return M_budget; }
+
+	const residency_stats &stats(resource_category category) const { return M_stats[static_cast<std::size_t>(category)]; }
+	std::size_t total_bytes() const { return M_total; }
+	// evictions since the start of the program
+	std::size_t evictions() const { return M_evictions; }
+
+	// lets the texture be evicted, an empty restore makes it pinned again (restoring it first if it's evicted)
+	void set_evictable(texture &text, restore_callback restore);
+	bool is_evictable(const texture &text) const { return M_evictable.contains(&text); }
+	bool is_evicted(const texture &text) const;
+
+	// marks the texture as used by the current frame, and restores it if it was evicted
+	void make_resident(const texture &text);
+
+	// starts a new frame, window::run calls it before drawing
+	void next_frame() { ++M_frame; }
+
+	// called by the resources themselves. Textures are keyed by their address, everything else by its OpenGL name
+	void track(resource_category category, uintptr_t key, std::size_t bytes);
+	void untrack(resource_category category, uintptr_t key);
+	// a texture was moved into another object
+	void moved(const texture &from, const texture &to);
+	// a texture is about to be destroyed
+	void forget(const texture &text);
+
+private:
+	struct evictable
+	{
+		texture *text;
+		restore_callback restore;
+		uint64_t last_used;
+		bool evicted;
+	};
+
+	residency_manager();
+
+	std::array<std::unordered_map<uintptr_t, std::size_t>, static_cast<std::size_t>(resource_category::count)> M_sizes;
+	std::array<residency_stats, static_cast<std::size_t>(resource_category::count)> M_stats;
+	std::size_t M_total;
+	std::size_t M_budget;
+	std::size_t M_evictions;
+	uint64_t M_frame;
+
+	// least recently used first
+	std::list<evictable> M_lru;
+	std::unordered_map<const texture *, std::list<evictable>::iterator> M_evictable;
+
+	// evicts textures until the budget is met, except the texture keyed skip
+	void make_room(uintptr_t skip);
+	void restore(evictable &entry);
+};
+
+DETAIL_BEG
+
+inline uintptr_t residency_key(const texture *text)
+{
+	return reinterpret_cast<uintptr_t>(text);
+}
+
+DETAIL_END
+
+SGUI_END
+
+#endif
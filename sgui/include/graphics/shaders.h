@@ -56,6 +56,8 @@ public:
 	void set_uniform(const std::string &name, const mat3 &val);
 	void set_uniform(const std::string &name, const mat4 &val);
 
+	// binds val to the sampler name on bind(). Shaders declaring a "uniform bool <name>_top_left" get whether val is top left with it,
+	// and sample at vec2(u, <name>_top_left ? 1.0 - v : v) like texture::sample_v
 	void set_uniform(const std::string &name, const texture &val);
 
 	void bind();
@@ -65,7 +67,14 @@ public:
 private:
 	unsigned int id;
 
-	std::map<int, const texture *> textures;
+	struct sampler
+	{
+		const texture *text;
+		// location of <name>_top_left, -1 if the shader doesn't declare it
+		int top_left_loc;
+	};
+
+	std::map<int, sampler> textures;
 
 	void destroy();
 	int get_loc(const std::string &name);
@@ -2,46 +2,130 @@
 #define TEXTURES_H
 #include "macro.h"
 #include "utils/context_lock.h"
+#include "graphics/residency.h"
 
 #include <string>
 #include <GL/glew.h>
 
 SGUI_BEG
 
+DETAIL_BEG
+// ring of pixel unpack buffers that streamed updates go through
+// each update writes the next buffer, orphaning its old storage, so the cpu never waits on the transfer of the previous update
+struct pixel_stream
+{
+	static constexpr int max_buffers = 3;
+
+	GLuint buffers[max_buffers];
+	GLsizeiptr sizes[max_buffers];
+	int count;
+	int next;
+};
+
+class texture_cache_view;
+DETAIL_END
+
+// row the pixel data of a texture starts with. OpenGL samples v = 0 from the first row, so top left textures have to be sampled with v flipped
+// (see texture::sample_v, and shader::set_uniform for shaders), which is how images stored top to bottom are uploaded without reordering their rows
+enum class texture_origin
+{
+	bottom_left,
+	top_left
+};
+
+enum class mip_policy
+{
+	// mipmaps only if min_filter samples them
+	automatic,
+	// a single level
+	none,
+	// levels are generated from the first one after every load
+	generate,
+	// the caller uploads every level (ex. texture caches)
+	provided
+};
+
+// how a texture's storage is allocated and sampled
+struct texture_desc
+{
+	// GL_RED, GL_RG, GL_RGB, GL_RGBA or GL_DEPTH_COMPONENT, stored with 8 bits per channel (24 for depth)
+	GLenum format = GL_RGBA;
+	// levels of the mip chain, 0 for all of them down to 1x1. Only used when the texture is mipmapped
+	GLsizei levels = 0;
+	mip_policy mips = mip_policy::automatic;
+	GLenum min_filter = GL_NEAREST;
+	GLenum mag_filter = GL_NEAREST;
+	GLenum wrap_s = GL_CLAMP_TO_BORDER;
+	GLenum wrap_t = GL_CLAMP_TO_BORDER;
+	// storage stays mutable, so allocating another size or format keeps the texture object (framebuffer attachments, index()).
+	// Otherwise it's immutable with ARB_texture_storage, which drivers validate once, and reallocating it replaces the texture object
+	bool resizable = false;
+};
+
 class texture
 {
 	GLuint id;
 	int width;
 	int height;
 	int nr_channels;
+	texture_origin origin;
+	// parameters the texture's storage was allocated with, and its sampling parameters currently are
+	texture_desc description;
+	GLsizei levels;
+	// allocated with glTexStorage2D, whose size and format can't change
+	bool immutable;
+	detail::pixel_stream stream;
+
+	void load_cache(const detail::texture_cache_view &cache, GLenum target_format);
 
 public:
-	inline texture() : id{}, width{}, height{}, nr_channels{} {}
+	inline texture() : id{}, width{}, height{}, nr_channels{}, origin{ texture_origin::bottom_left }, description{}, levels{}, immutable{}, stream{ .buffers = {}, .sizes = {}, .count = detail::pixel_stream::max_buffers, .next = 0 } {}
 	inline ~texture()
 	{
+		residency_manager::get().forget(*this);
 		destroy();
 	}
 
-	inline texture(const std::string &file_name, GLenum target_format) : id{}
+	inline texture(const std::string &file_name, GLenum target_format) : texture()
 	{
 		load(file_name, target_format);
 	}
 
-	inline texture(GLenum target_format, const void *data, GLsizei width, GLsizei height, int channel_count, bool flip = true) : id{}
+	inline texture(GLenum target_format, const void *data, GLsizei width, GLsizei height, int channel_count, bool flip = true) : texture()
 	{
 		load(target_format, data, width, height, channel_count, flip);
 	}
 
-	inline texture(texture &&other) noexcept : id{ other.id }, width{ other.width }, height{ other.height }, nr_channels{ other.nr_channels }
+	inline texture(GLenum target_format, const void *data, GLsizei width, GLsizei height, int channel_count, texture_origin origin) : texture()
 	{
-		other.id = other.width = other.height = other.nr_channels = 0;
+		load(target_format, data, width, height, channel_count, origin);
+	}
+
+	inline texture(texture &&other) noexcept : id{ other.id }, width{ other.width }, height{ other.height }, nr_channels{ other.nr_channels }, origin{ other.origin }, description{ other.description }, levels{ other.levels }, immutable{ other.immutable }, stream{ other.stream }
+	{
+		other.id = other.width = other.height = other.nr_channels = other.levels = 0;
+		other.immutable = false;
+		other.stream = { .buffers = {}, .sizes = {}, .count = detail::pixel_stream::max_buffers, .next = 0 };
+		residency_manager::get().moved(other, *this);
 	}
 
 	inline texture &operator=(texture &&other) noexcept
 	{
+		residency_manager::get().forget(*this);
 		destroy();
 		id = other.id;
-		other.id = other.width = other.height = other.nr_channels = 0;
+		width = other.width;
+		height = other.height;
+		nr_channels = other.nr_channels;
+		origin = other.origin;
+		description = other.description;
+		levels = other.levels;
+		immutable = other.immutable;
+		stream = other.stream;
+		other.id = other.width = other.height = other.nr_channels = other.levels = 0;
+		other.immutable = false;
+		other.stream = { .buffers = {}, .sizes = {}, .count = detail::pixel_stream::max_buffers, .next = 0 };
+		residency_manager::get().moved(other, *this);
 		return *this;
 	}
 
@@ -57,9 +141,21 @@ public:
 		glBindTexture(GL_TEXTURE_2D, id);
 	}
 
+	// the size, description and residency of the texture are kept, so an evicted texture can be allocated again
 	inline void destroy()
 	{
+		auto &residency = residency_manager::get();
+		residency.untrack(resource_category::texture, detail::residency_key(this));
+		for (GLuint buffer : stream.buffers)
+			if (buffer)
+				residency.untrack(resource_category::buffer, buffer);
+
 		glDeleteTextures(1, &id);
+		glDeleteBuffers(detail::pixel_stream::max_buffers, stream.buffers);
+		id = 0;
+		levels = 0;
+		immutable = false;
+		stream = { .buffers = {}, .sizes = {}, .count = stream.count, .next = 0 };
 	}
 
 	inline unsigned int index() const
@@ -72,6 +168,23 @@ public:
 		detail::texture_lock lock;
 		use();
 		glTexParameteri(GL_TEXTURE_2D, property, value);
+
+		// keeps the description in sync, so allocate knows which parameters it has to set
+		switch (property)
+		{
+		case GL_TEXTURE_MIN_FILTER:
+			description.min_filter = static_cast<GLenum>(value);
+			break;
+		case GL_TEXTURE_MAG_FILTER:
+			description.mag_filter = static_cast<GLenum>(value);
+			break;
+		case GL_TEXTURE_WRAP_S:
+			description.wrap_s = static_cast<GLenum>(value);
+			break;
+		case GL_TEXTURE_WRAP_T:
+			description.wrap_t = static_cast<GLenum>(value);
+			break;
+		}
 	}
 
 	inline void set_parameter(GLenum property, const GLint *value)
@@ -110,11 +223,70 @@ public:
 		return nr_channels;
 	}
 
+	inline const texture_desc &get_description() const
+	{
+		return description;
+	}
+
+	// levels of the texture's storage
+	inline int get_levels() const
+	{
+		return levels;
+	}
+
+	inline texture_origin get_origin() const
+	{
+		return origin;
+	}
+
+	// texture coordinate to sample at to get the pixel at v, counted from the bottom of the image
+	inline float sample_v(float v) const
+	{
+		return origin == texture_origin::top_left ? 1 - v : v;
+	}
+
+	// texture cache files (see convert_texture) are mapped and uploaded as they are, along with their mip levels. qoi files are decoded by qoi,
+	// other images by stb_image, and uploaded top left without reordering their rows
 	void load(const std::string &file_name, GLenum target_format);
 
+	// rows of data are top to bottom if flip is set, and flipped on the cpu so the texture is bottom left. Prefer the overload taking an origin,
+	// which doesn't copy. The flipped rows are uploaded a band of up to 1 MiB at a time, through a buffer released before returning
 	void load(GLenum target_format, const void *data, GLsizei width, GLsizei height, int channel_count, bool flip = true);
+	// uploads data as is, origin is the row it starts with
+	void load(GLenum target_format, const void *data, GLsizei width, GLsizei height, int channel_count, texture_origin origin);
+	// allocates storage for desc, and uploads data into its first level. Mipmaps are generated from it unless desc provides them
+	void load(const texture_desc &desc, const void *data, GLsizei width, GLsizei height, int channel_count, texture_origin origin = texture_origin::bottom_left);
+
+	// allocates storage without any pixels. Allocating the same storage again only updates the sampling parameters that changed.
+	// Allocating another size or format keeps the texture object if desc is resizable, or storage is mutable (no ARB_texture_storage).
+	// Otherwise index() changes, and the texture has to be attached to framebuffers again
+	// returns false, and logs an error, if desc is invalid
+	bool allocate(const texture_desc &desc, GLsizei width, GLsizei height);
+	// allocate with the default description, a single level and resizable storage, so reserving another size keeps index() and framebuffer attachments.
+	// Use allocate for immutable storage
 	void reserve(GLenum target_format, GLsizei width, GLsizei height);
 
+	// uploads data (unsigned bytes) into a region of an already allocated texture
+	void sub_image(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, const void *data);
+
+	// streaming updates of a region of an already allocated texture (ex. camera frames), without reallocating it or regenerating mipmaps
+	// pixels are unsigned bytes in format, rows bottom to top and tightly packed. The upload goes through the next pixel buffer of the texture's ring,
+	// so the call returns once the pixels are copied, and writing the next update overlaps the transfer of this one
+	void update_region(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, const void *data);
+
+	// same as update_region, but returns the pixel buffer to write the pixels into, which skips update_region's copy
+	// write width * height pixels, then call commit_region with the same arguments before any other call to the texture. Null on failure
+	void *map_region(GLsizei width, GLsizei height, GLenum format);
+	void commit_region(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format);
+
+	// uploads from a pixel unpack buffer owned by the caller, starting offset bytes in, without any copy on the cpu
+	// named apart from update_region, since a literal 0 would convert to either the pixels or the buffer
+	void update_region_from_buffer(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLuint pixel_buffer, GLintptr offset = 0);
+
+	// number of pixel buffers streamed updates rotate through, 2 or 3 (the default)
+	void set_stream_buffers(int count);
+	int get_stream_buffers() const { return stream.count; }
+
 	inline static void quit()
 	{
 		glBindTexture(GL_TEXTURE_2D, 0);
@@ -0,0 +1,71 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "macro.h"
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <GL/glew.h>
+
+SGUI_BEG
+
+// sgui's own texture file, which texture::load uploads without decoding anything
+// a header, a table of mip levels, and the levels' raw pixels in the format they're uploaded in, rows bottom to top and tightly packed.
+// Fields are in the byte order of the machine that wrote the file, little endian on everything sgui runs on
+struct texture_cache_header
+{
+	static constexpr char magic_bytes[4] = { 'S', 'G', 'T', 'X' };
+	static constexpr uint32_t current_version = 1;
+
+	char magic[4];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	// GL_RED, GL_RG, GL_RGB or GL_RGBA, in unsigned bytes
+	uint32_t format;
+	// levels in the table after the header, at least 1. A single level is mipmapped on upload like any other image
+	uint32_t levels;
+};
+
+struct texture_cache_level
+{
+	// from the start of the file, aligned to 16 bytes
+	uint64_t offset;
+	uint32_t width;
+	uint32_t height;
+};
+
+// decodes image_file (like texture::load does) and writes it to cache_file, converted to the channels of target_format (GL_RED, GL_RG, GL_RGB or GL_RGBA)
+// with mipmaps set, the whole mip chain is built (box filtered) and stored, so the upload doesn't generate it
+// returns false, and logs an error, on failure
+bool convert_texture(const std::string &image_file, const std::string &cache_file, GLenum target_format, bool mipmaps = true);
+
+DETAIL_BEG
+
+// validated view over the bytes of a texture cache file
+class texture_cache_view
+{
+public:
+	texture_cache_view() : M_header{}, M_levels{}, M_data{} {}
+
+	// returns false if data isn't a texture cache, or a truncated or corrupt one
+	bool open(const unsigned char *data, std::size_t size);
+
+	static bool is_cache(const unsigned char *data, std::size_t size);
+
+	const texture_cache_header &header() const { return *M_header; }
+	const texture_cache_level &level(uint32_t i) const { return M_levels[i]; }
+	const unsigned char *pixels(uint32_t i) const { return M_data + M_levels[i].offset; }
+
+private:
+	const texture_cache_header *M_header;
+	const texture_cache_level *M_levels;
+	const unsigned char *M_data;
+};
+
+DETAIL_END
+
+SGUI_END
+
+#endif
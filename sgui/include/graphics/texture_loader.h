@@ -0,0 +1,84 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include "macro.h"
+#include "graphics/texture.h"
+#include "utils/thread_pool.h"
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <future>
+#include <chrono>
+#include <mutex>
+#include <deque>
+#include <atomic>
+
+SGUI_BEG
+
+// loads image files without blocking the thread that owns the OpenGL context
+// files are decoded (by qoi or stb_image, like texture::load) on a thread pool, and the decoded pixels are uploaded by upload(), which spends at most a time budget per call.
+// window::run drains the shared loader (get()) once per frame with its frame budget
+class texture_loader
+{
+public:
+	// called on the OpenGL thread once the texture is uploaded, ok is false if the file couldn't be decoded
+	using callback = std::function<void(texture &text, bool ok)>;
+
+	struct result
+	{
+		// a 1x1 transparent placeholder until the image is uploaded, the same texture then holds the image
+		std::shared_ptr<texture> text;
+		// becomes ready once the image is uploaded (or failed to decode). Never wait for it on the OpenGL thread, which is the one uploading it
+		std::shared_future<bool> done;
+	};
+
+	// the pool is only started by the first load
+	explicit texture_loader(unsigned int threads = 0);
+	// images that haven't been uploaded yet are dropped
+	~texture_loader();
+
+	texture_loader(const texture_loader &) = delete;
+	texture_loader &operator=(const texture_loader &) = delete;
+
+	// loader drained by window::run
+	static texture_loader &get();
+
+	// returns immediately, call from the thread that owns the OpenGL context (it creates the placeholder)
+	// if every handle to the texture is dropped before the image is uploaded, the upload is skipped
+	result load(const std::string &file_name, GLenum target_format, callback on_done = {});
+
+	// uploads decoded images until budget is spent, at least one per call so loading always progresses. Returns how many were uploaded
+	// call from the thread that owns the OpenGL context
+	std::size_t upload(std::chrono::microseconds budget);
+
+	// time window::run gives upload() every frame, 2 ms by default
+	void set_frame_budget(std::chrono::microseconds budget) { M_frame_budget = budget; }
+	std::chrono::microseconds get_frame_budget() const { return M_frame_budget; }
+
+	// called from a worker thread whenever an image is ready to upload, ex. to wake up an event loop waiting for input
+	// set it before the first load
+	void set_ready_callback(std::function<void()> ready) { M_ready_callback = std::move(ready); }
+
+	// images still being decoded or waiting for upload
+	std::size_t pending() const { return M_pending.load(std::memory_order_relaxed); }
+
+private:
+	struct job;
+
+	std::deque<std::shared_ptr<job>> M_ready;
+	std::mutex M_mutex;
+	std::atomic<std::size_t> M_pending;
+	std::chrono::microseconds M_frame_budget;
+	std::function<void()> M_ready_callback;
+	unsigned int M_threads;
+
+	// declared last, so workers are stopped before anything they use is destroyed
+	std::unique_ptr<thread_pool> M_pool;
+
+	void decode(const std::shared_ptr<job> &cur);
+};
+
+SGUI_END
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef TILE_PYRAMID_H
+#define TILE_PYRAMID_H
+
+#include "macro.h"
+#include "utils/mapped_file.h"
+
+#include <string>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+SGUI_BEG
+
+// an image split into square tiles at every level of its mip chain, for images too large to fit in a texture (see tiled_image)
+// level l is the image scaled down by 2^l (rounding sizes up), down to the first level that fits in a single tile.
+// Tiles are rgba, rows top to bottom, and carry a border of one pixel copied from their neighbours (repeating the image's edges),
+// so they're filtered seamlessly when sampled on their own
+class tile_source
+{
+public:
+	tile_source() : M_width{}, M_height{}, M_tile_size{}, M_levels{} {}
+	virtual ~tile_source() = default;
+
+	uint32_t width() const { return M_width; }
+	uint32_t height() const { return M_height; }
+	// pixels of a tile, without its border
+	uint32_t tile_size() const { return M_tile_size; }
+	// pixels of a tile, with its border
+	uint32_t tile_stride() const { return M_tile_size + 2; }
+	uint32_t levels() const { return M_levels; }
+
+	uint32_t level_width(uint32_t level) const { return level_size(M_width, level); }
+	uint32_t level_height(uint32_t level) const { return level_size(M_height, level); }
+	uint32_t columns(uint32_t level) const { return (level_width(level) + M_tile_size - 1) / M_tile_size; }
+	uint32_t rows(uint32_t level) const { return (level_height(level) + M_tile_size - 1) / M_tile_size; }
+
+	// writes tile_stride() * tile_stride() rgba pixels of the tile into rgba. Returns false if the tile couldn't be read
+	// called from worker threads, several tiles at a time
+	virtual bool read_tile(uint32_t level, uint32_t column, uint32_t row, unsigned char *rgba) const = 0;
+
+protected:
+	// sets the image's size, and the levels its tiles span. Returns false if the sizes are 0
+	bool set_geometry(uint32_t width, uint32_t height, uint32_t tile_size);
+
+private:
+	uint32_t M_width;
+	uint32_t M_height;
+	uint32_t M_tile_size;
+	uint32_t M_levels;
+
+	static uint32_t level_size(uint32_t size, uint32_t level)
+	{
+		return static_cast<uint32_t>(((uint64_t{ size } + (uint64_t{ 1 } << level) - 1) >> level));
+	}
+};
+
+// sgui's tile pyramid file, the tiles of every level stored uncompressed, so they're read straight from a mapping of the file
+// a header, a table of levels, and each level's tiles row by row. Fields are in the byte order of the machine that wrote the file
+struct tile_pyramid_header
+{
+	static constexpr char magic_bytes[4] = { 'S', 'G', 'T', 'L' };
+	static constexpr uint32_t current_version = 1;
+
+	char magic[4];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t tile_size;
+	// levels in the table after the header
+	uint32_t levels;
+};
+
+struct tile_pyramid_level
+{
+	// from the start of the file, aligned to 16 bytes
+	uint64_t offset;
+	uint32_t columns;
+	uint32_t rows;
+};
+
+// decodes image_file (like texture::load does) and writes its tiles to pyramid_file, tile_size being a power of two from 16 to 1024
+// the decoded image and its next level are held in memory while converting, the tiles are written as they're cut
+// returns false, and logs an error, on failure
+bool convert_tile_pyramid(const std::string &image_file, const std::string &pyramid_file, uint32_t tile_size = 256);
+
+// tiles read from a mapped tile pyramid file. Only the pages of the tiles read are loaded, so files can be larger than memory
+class tile_pyramid : public tile_source
+{
+public:
+	tile_pyramid() : M_levels{} {}
+
+	// returns false, and logs an error, if the file can't be opened or isn't a valid tile pyramid
+	bool open(const std::string &file_name);
+	bool is_open() const { return M_levels != nullptr; }
+
+	bool read_tile(uint32_t level, uint32_t column, uint32_t row, unsigned char *rgba) const override;
+
+private:
+	detail::mapped_file M_file;
+	const tile_pyramid_level *M_levels;
+};
+
+SGUI_END
+
+#endif
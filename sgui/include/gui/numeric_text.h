@@ -0,0 +1,146 @@
+#ifndef NUMERIC_TEXT_H
+#define NUMERIC_TEXT_H
+
+#include "macro.h"
+#include "gui/widget.h"
+#include "gui/text_layout.h"
+
+#include <array>
+#include <algorithm>
+#include <charconv>
+#include <concepts>
+#include <string_view>
+#include <cstdint>
+
+SGUI_BEG
+
+class font;
+class window;
+
+// label for a number that changes every frame (ex. telemetry readouts)
+// the number is formatted with std::to_chars into an inline buffer, and glyphs come from a table of the characters numbers are made of,
+// built once per font. Digits all take the advance of the widest one, so the label doesn't jitter as the value changes.
+// Only the quads of characters that changed are updated, and setting a value never allocates
+class numeric_text : public colorable
+{
+public:
+	static ptr_handle<numeric_text> make(font &_font)
+	{
+		return ptr_handle<numeric_text>(new numeric_text(_font));
+	}
+
+	virtual ~numeric_text() = default;
+
+	// longest string a value is formatted to
+	static constexpr std::size_t capacity = 32;
+
+	template <std::integral T>
+	void set_value(T value)
+	{
+		char buffer[capacity];
+		auto res = std::to_chars(buffer, buffer + capacity, value);
+		assign(buffer, res.ptr);
+	}
+
+	template <std::floating_point T>
+	void set_value(T value)
+	{
+		char buffer[capacity];
+		auto res = M_precision < 0 ? std::to_chars(buffer, buffer + capacity, value) : std::to_chars(buffer, buffer + capacity, value, std::chars_format::fixed, M_precision);
+
+		// values too large for fixed notation fall back to scientific, then to the shortest representation
+		if (res.ec != std::errc{} && M_precision >= 0)
+			res = std::to_chars(buffer, buffer + capacity, value, std::chars_format::scientific, M_precision);
+		if (res.ec != std::errc{})
+			res = std::to_chars(buffer, buffer + capacity, value);
+
+		// nothing fit, the label is cleared rather than showing the buffer
+		assign(buffer, res.ec == std::errc{} ? res.ptr : buffer);
+	}
+
+	// most digits after the decimal point that still fit in capacity in scientific notation (sign, digit, point, exponent of up to 4 digits)
+	static constexpr int max_precision = static_cast<int>(capacity) - 9;
+
+	// digits after the decimal point of floating point values, negative for the shortest representation that round trips
+	// clamped to max_precision, and only applies to values set afterwards
+	void set_precision(int digits) { M_precision = std::min(digits, max_precision); }
+	int get_precision() const { return M_precision; }
+
+	// the formatted value
+	std::string_view get_string() const { return { M_chars.data(), M_size }; }
+
+	// left aligned labels grow to the right of the origin, right aligned ones to the left, and centered ones both ways
+	void set_alignment(text_align align);
+	text_align get_alignment() const { return M_align; }
+
+	void set_text_origin(vec2 origin) { M_origin = origin; }
+	vec2 get_text_origin() const { return M_origin; }
+
+	void set_scale(vec2 scale) { M_scale = scale; }
+	vec2 get_scale() const { return M_scale; }
+
+	// rebuilds the glyph table, and lays out the current value again
+	void set_font(font &_font);
+	font const *get_font() const noexcept { return M_font; }
+
+	// same as text::get_local_rect
+	bound get_local_rect() const;
+
+	void draw_raw(const window *win, vec2 absolute_min) const override;
+
+protected:
+	numeric_text(font &_font);
+
+	void obj_init() override;
+
+private:
+	// characters std::to_chars can produce, including "inf" and "nan"
+	static constexpr std::string_view glyph_chars = "0123456789-+.einfa";
+
+	struct glyph
+	{
+		uint32_t code_point;
+		vec2 offset;
+		vec2 size;
+		float advance;
+	};
+
+	struct quad
+	{
+		vec2 min;
+		vec2 max;
+		// index in M_glyphs, glyphs without a bitmap (ex. spaces) aren't drawn
+		uint8_t glyph;
+	};
+
+	std::array<char, capacity> M_chars;
+	// the glyph table and the layout are rebuilt when the font's generation changes, from the const getters like text::update_bounds
+	mutable std::array<quad, capacity> M_quads;
+	mutable std::array<glyph, glyph_chars.size()> M_glyphs;
+	// characters outside of glyph_chars can't be formatted, so this only maps ascii
+	mutable std::array<uint8_t, 128> M_glyph_of;
+	// generation of the font's face the glyph table was built with
+	mutable uint64_t M_generation;
+
+	std::size_t M_size;
+	int M_precision;
+
+	// pen position of every character, relative to the start of the label
+	mutable std::array<float, capacity + 1> M_pens;
+	mutable bound M_bound;
+	vec2 M_origin;
+	vec2 M_scale;
+	text_align M_align;
+	font *M_font;
+
+	void assign(const char *begin, const char *end);
+	void build_glyphs() const;
+	// updates the quads of characters from first on, and the bounds
+	void layout(std::size_t first) const;
+	// rebuilds the glyph table and the layout if fallbacks or subpixel variants changed the font's metrics since it was built
+	void update_glyphs() const;
+};
+
+SGUI_END
+
+#endif
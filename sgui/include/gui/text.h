@@ -2,11 +2,22 @@
 #define TEXT_H
 #include "math/vec.h"
 #include "graphics/texture.h"
+#include "graphics/glyph_atlas.h"
 
 #include "gui/widget.h"
+#include "gui/text_layout.h"
+
+#include "utils/glyph_table.h"
 
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <type_traits>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <memory>
+#include <vector>
 
 struct FT_FaceRec_;
 
@@ -18,23 +29,22 @@ DETAIL_END
 
 class window;
 
-struct bound
-{
-	vec2 min;
-	vec2 dims;
-
-	vec2 max() const
-	{
-		return min + dims;
-	}
-};
-
 class font
 {
 public:
 	static constexpr unsigned int default_height = 48;
 
-	font() : M_chars(256) {}
+	struct glyph_metrics
+	{
+		// position of the glyph's bitmap (left, top) relative to the pen on the baseline
+		ivec2 offset;
+		// dimensions of the glyph's bitmap
+		ivec2 size;
+		// horizontal advance in 26.6 fixed point
+		unsigned int advance;
+	};
+
+	font();
 
 	font(const std::string &file_name, unsigned int height) : font()
 	{
@@ -45,13 +55,82 @@ public:
 		load(data, size, height);
 	}
 
+	// fonts are handles to a face and glyph cache shared through the font registry, so copies are cheap
+	font(const font &) = default;
+	font &operator=(const font &) = default;
+	font(font &&) noexcept = default;
+	font &operator=(font &&) noexcept = default;
+
+	// faces are interned by (file, height) and (data, height), so loading the same font twice shares its face and glyphs
 	void load(const std::string &file_name, unsigned int height);
+	// data is copied the first time a face is created from it
 	void load(const void *data, std::size_t size, unsigned int height);
 
-	unsigned int get_character_height() const { return face.size; }
+	unsigned int get_character_height() const { return M_face->face.size; }
+	// distance between two baselines recommended by the font
+	unsigned int get_line_spacing() const;
+	// distance from the baseline to the top of the tallest glyphs
+	unsigned int get_ascender() const;
+
+	// the functions below only use freetype metrics (no OpenGL), so they can be called from any thread
+
+	glyph_metrics get_metrics(uint32_t c) const;
+
+	// changes whenever the metrics get_metrics returns can change (fallbacks or subpixel variants were changed), for code that caches them
+	uint64_t get_generation() const;
+
+	// bounds of str laid out with no wrapping, the same as text::get_local_rect with a scale of 1
+	bound measure(code_point_view str) const;
+	// str is decoded as utf-8
+	bound measure(std::string_view str) const;
+
+	// true if both fonts share the same face and glyph cache
+	bool shares_face(const font &other) const { return M_face == other.M_face; }
+
+	// number of faces currently alive in the font registry
+	static std::size_t registry_size();
+
+	// number of laid out runs currently shared through the run cache
+	static std::size_t run_cache_size();
+
+	// code points missing from this font are looked up in the fallbacks, in order, and the first face that has them is remembered per code point
+	// fallback glyphs are cached in this font's atlas, so they're drawn in the same batch
+	// fallbacks belong to the shared face, so they apply to every font that shares_face with this one.
+	// Changing them drops the glyphs cached so far, so only do it from the thread that owns the OpenGL context, while no other thread uses the font.
+	// Texts using the font are laid out again with the new metrics the next time they're measured or drawn
+	void add_fallback(const font &fallback);
+	void clear_fallbacks();
+	std::size_t fallback_count() const;
+
+	static constexpr std::size_t max_fallbacks = 255;
+
+	// glyphs are rasterized at up to count horizontal subpixel offsets, picked from the fraction of the pen's 26.6 position,
+	// and advances keep their fraction instead of being rounded down to whole pixels. Variants are rasterized lazily into the atlas,
+	// so the sharper spacing costs atlas memory rather than per-frame work. 1 (the default) disables them
+	// like fallbacks, this belongs to the shared face and drops the glyphs cached so far
+	void set_subpixel_variants(unsigned int count);
+	unsigned int get_subpixel_variants() const;
+
+	static constexpr unsigned int max_subpixel_variants = 4;
+
+	// glyph bitmaps are cached in atlas pages, evicted least recently used first once a budget is exceeded
+	// only use these from the thread that owns the OpenGL context
+
+	// texture memory this face's glyphs may use, 0 leaves only the global budget
+	void set_cache_budget(std::size_t bytes) { M_face->atlas.set_budget(bytes); }
+	std::size_t get_cache_budget() const { return M_face->atlas.get_budget(); }
+	const glyph_cache_stats &get_cache_stats() const { return M_face->atlas.stats(); }
+
+	// texture memory shared by the glyphs of every font, 64 MiB by default. 0 means no limit
+	static void set_global_cache_budget(std::size_t bytes) { detail::glyph_atlas::set_global_budget(bytes); }
+	static std::size_t get_global_cache_budget() { return detail::glyph_atlas::get_global_budget(); }
+	static const glyph_cache_stats &get_global_cache_stats() { return detail::glyph_atlas::global_stats(); }
 
 private:
 	friend class text;
+	friend class text_view;
+	friend class numeric_text;
+	friend class paragraph_layout;
 
 	struct face_handle
 	{
@@ -70,37 +149,133 @@ private:
 		void resize();
 	};
 
-	face_handle face;
+	struct shared_face;
+
+	// bitmap of a glyph rasterized with its outline shifted right by a fraction of a pixel. Only the horizontal extents change
+	struct glyph_variant
+	{
+		detail::atlas_slot slot;
+		int offset_x;
+		int width;
+	};
 
-	struct character
+	struct character : glyph_metrics
 	{
-		character() noexcept : text{}, offset{}, advance{}, height{} {}
+		character() noexcept : glyph_metrics{}, slot{}, variants{}, face{} {}
+
+		// picks the face that has c and loads its metrics. Locks the faces it looks at
+		void load(shared_face &_face, uint32_t c);
+		// rasterizes a variant of the glyph into the face's atlas. Must be called on the thread that owns the OpenGL context
+		void render(shared_face &_face, uint32_t c, unsigned int variant = 0);
+
+		// empty glyphs have nothing to rasterize
+		bool resident(unsigned int variant = 0) const { return slot_of(variant).page || !width_of(variant) || !size.y; }
+
+		detail::atlas_slot &slot_of(unsigned int variant) { return variant ? variants[variant - 1].slot : slot; }
+		const detail::atlas_slot &slot_of(unsigned int variant) const { return variant ? variants[variant - 1].slot : slot; }
+		int offset_x_of(unsigned int variant) const { return variant ? variants[variant - 1].offset_x : offset.x; }
+		int width_of(unsigned int variant) const { return variant ? variants[variant - 1].width : size.x; }
+
+		// slot of the unshifted glyph, described by the glyph_metrics
+		detail::atlas_slot slot;
+		// variants 1 and up, only used while the face has subpixel variants
+		std::array<glyph_variant, max_subpixel_variants - 1> variants;
+		// 0 for the primary face, i for fallback i - 1
+		uint8_t face;
+
+	private:
+		// extents of the shifted variants, from the outline loaded in face's glyph slot
+		void load_variants(FT_FaceRec_ *src, unsigned int count);
+	};
 
-		character(const font *_font, uint32_t c);
-		~character() = default;
+	// one per interned (source, height), shared by every font loaded from it
+	struct shared_face
+	{
+		shared_face(unsigned int height) : atlas{ height } {}
+
+		face_handle face;
+		// owned copy of the font file for faces loaded from memory, freetype reads from it lazily
+		std::vector<unsigned char> data;
+
+		detail::glyph_table<character> chars;
+		std::vector<std::shared_ptr<shared_face>> fallbacks;
+		// bumped whenever cached metrics are dropped, so cached runs laid out with them are missed
+		uint64_t generation = 0;
+		// number of subpixel variants glyphs are rasterized at
+		unsigned int subpixel = 1;
+		// guards inserting into chars, fallbacks and the freetype face, which isn't thread safe. Finding in chars needs no lock
+		std::mutex mutex;
+
+		// declared after chars, so it's destroyed before the slots pointing into it
+		detail::glyph_atlas atlas;
+	};
 
-		character(character &&other) noexcept;
-		character &operator=(character &&other) noexcept;
+	std::shared_ptr<shared_face> M_face;
 
-		void load(const font *_font, uint32_t c);
+	// lays out str with the settings of layout, or returns the run laid out by another text with the same key
+	std::shared_ptr<const shaped_run> shape(code_point_view str, const paragraph_layout &layout) const;
 
-		texture text;
+	// metrics only, safe to call from any number of threads
+	// cached glyphs are found without locking, a missing glyph is loaded and then inserted while holding the face's lock, so there's a single writer.
+	// Two threads missing the same glyph both load it, and the first insert wins
+	character const *at(uint32_t c) const
+	{
+		if (auto *res = M_face->chars.find(c))
+			return res;
 
-		ivec2 offset;
-		unsigned int advance;
+		// resolved without holding the lock, since it may lock fallback faces
+		character res;
+		res.load(*M_face, c);
 
-		unsigned int height;
-	};
+		std::lock_guard lock(M_face->mutex);
+		return &M_face->chars.find_or_insert(c, [&res](character &ch) { ch = res; });
+	}
 
-	character const *at(uint32_t c) const
+	// metrics and atlas slot, only call from the thread that owns the OpenGL context
+	// the slot's page stays resident until the next glyph_atlas::begin_batch
+	character const *rendered_at(uint32_t c) const
 	{
-		if (!M_chars.count(c))
-			return &M_chars.emplace(c, character{ this, c }).first->second;
-		return &M_chars.at(c);
+		auto *res = at(c);
+		if (!res->resident())
+			const_cast<character *>(res)->render(*M_face, c);
+		else if (res->slot.page)
+			detail::glyph_atlas::touch(res->slot.page);
+		return res;
 	}
 
-	// mutable to allow potential addition of new characters in draw function
-	mutable std::unordered_map<uint32_t, character> M_chars;
+	// horizontal advance in pixels, which keeps its fraction while the face has subpixel variants
+	float pen_advance(const glyph_metrics &glyph) const
+	{
+		return M_face->subpixel > 1 ? static_cast<float>(glyph.advance) / 64 : static_cast<float>(glyph.advance >> 6);
+	}
+
+	struct glyph_bitmap
+	{
+		const character *ch;
+		const detail::atlas_slot *slot;
+		// left edge of the bitmap, on the same axis as the pen
+		float left;
+		ivec2 size;
+	};
+
+	// the variant of c closest to a pen at x (in pixels), with the same residency rules as rendered_at(c)
+	glyph_bitmap rendered_at(uint32_t c, float x) const
+	{
+		unsigned int count = M_face->subpixel;
+		float whole = count > 1 ? std::floor(x) : x;
+
+		unsigned int variant = count > 1 ? std::min(static_cast<unsigned int>((x - whole) * count), count - 1) : 0;
+
+		auto *res = at(c);
+		auto &slot = res->slot_of(variant);
+
+		if (!res->resident(variant))
+			const_cast<character *>(res)->render(*M_face, c, variant);
+		else if (slot.page)
+			detail::glyph_atlas::touch(slot.page);
+
+		return { res, &slot, whole + res->offset_x_of(variant), { res->width_of(variant), res->size.y } };
+	}
 };
 
 class text : public colorable
@@ -126,30 +301,24 @@ public:
 		return ptr_handle<text>(new text(txt, _font));
 	}
 
-	static ptr_handle<text> make(std::basic_string_view<uint32_t> txt, font &_font)
+	static ptr_handle<text> make(code_point_view txt, font &_font)
 	{
 		return ptr_handle<text>(new text(txt, _font));
 	}
 
-	void set_string(std::basic_string_view<char> txt)
-	{
-		M_data.assign(txt.begin(), txt.end());
-		M_data_changed = true;
-	}
-
-	void set_string(std::basic_string_view<wchar_t> txt)
-	{
-		M_data.assign(txt.begin(), txt.end());
-		M_data_changed = true;
-	}
+	// txt is decoded as utf-8
+	void set_string(std::basic_string_view<char> txt);
+	// txt is decoded as utf-16 where wchar_t is 2 bytes (windows), and utf-32 otherwise
+	void set_string(std::basic_string_view<wchar_t> txt);
 
-	void set_string(std::basic_string_view<uint32_t> txt)
+	void set_string(code_point_view txt)
 	{
-		M_data.assign(txt.begin(), txt.end());
-		M_data_changed = true;
+		M_data.assign(txt);
+		M_layout.invalidate();
 	}
 
-	const std::basic_string<uint32_t> &get_string() const
+	// characters are stored with 1, 2 or 4 bytes each, depending on the widest one, so they're accessed through a view
+	code_point_view get_string() const
 	{
 		return M_data;
 	}
@@ -157,54 +326,119 @@ public:
 	void clear()
 	{
 		M_data.clear();
-		M_data_changed = true;
+		M_layout.invalidate();
 	}
 
-	template <typename... Ts>
-	void insert(Ts &&...args)
+	void replace(std::size_t pos, std::size_t count, code_point_view str)
 	{
-		M_data.insert(std::forward<Ts>(args)...);
-		M_data_changed = true;
+		pos = std::min(pos, M_data.size());
+		count = std::min(count, M_data.size() - pos);
+
+		M_data.replace(pos, count, str);
+		M_layout.invalidate(pos, count, str.size());
+		shift_spans(pos, count, str.size());
 	}
 
-	template <typename... Ts>
-	void erase(Ts &&...args)
+	// the overloads of std::basic_string's edits, which text forwarded before it stored compact strings
+	template <typename It> requires (!std::is_integral_v<It>)
+	void replace(code_point_view::iterator first, code_point_view::iterator last, It str_first, It str_last)
 	{
-		M_data.erase(std::forward<Ts>(args)...);
-		M_data_changed = true;
+		replace(first.index(), last - first, std::basic_string<uint32_t>(str_first, str_last));
 	}
 
-	void push_back(uint32_t c)
+	void replace(code_point_view::iterator first, code_point_view::iterator last, code_point_view str) { replace(first.index(), last - first, str); }
+	void replace(std::size_t pos, std::size_t count, code_point_view str, std::size_t str_pos, std::size_t str_count = npos) { replace(pos, count, str.substr(str_pos, str_count)); }
+	void replace(std::size_t pos, std::size_t count, const uint32_t *str, std::size_t str_count) { replace(pos, count, std::basic_string_view<uint32_t>(str, str_count)); }
+	void replace(std::size_t pos, std::size_t count, std::size_t fill_count, uint32_t c) { replace(pos, count, std::basic_string<uint32_t>(fill_count, c)); }
+
+	void insert(std::size_t pos, code_point_view str) { replace(pos, 0, str); }
+	void insert(std::size_t pos, code_point_view str, std::size_t str_pos, std::size_t str_count = npos) { replace(pos, 0, str.substr(str_pos, str_count)); }
+	void insert(std::size_t pos, const uint32_t *str, std::size_t count) { replace(pos, 0, std::basic_string_view<uint32_t>(str, count)); }
+
+	void insert(std::size_t pos, std::size_t count, uint32_t c)
 	{
-		M_data.push_back(c);
-		M_data_changed = true;
+		pos = std::min(pos, M_data.size());
+
+		M_data.insert(pos, count, c);
+		M_layout.invalidate(pos, 0, count);
+		shift_spans(pos, 0, count);
 	}
 
+	void insert(code_point_view::iterator pos, uint32_t c) { insert(pos.index(), 1, c); }
+	void insert(code_point_view::iterator pos, std::size_t count, uint32_t c) { insert(pos.index(), count, c); }
+
+	template <typename It> requires (!std::is_integral_v<It>)
+	void insert(code_point_view::iterator pos, It first, It last) { insert(pos.index(), std::basic_string<uint32_t>(first, last)); }
+
+	void erase(std::size_t pos = 0, std::size_t count = npos) { replace(pos, count, {}); }
+	void erase(code_point_view::iterator pos) { erase(pos.index(), 1); }
+	void erase(code_point_view::iterator first, code_point_view::iterator last) { erase(first.index(), last - first); }
+
+	void append(code_point_view str) { replace(M_data.size(), 0, str); }
+	void append(std::size_t count, uint32_t c) { insert(M_data.size(), count, c); }
+	void append(code_point_view str, std::size_t pos, std::size_t count = npos) { append(str.substr(pos, count)); }
+	void append(const uint32_t *str, std::size_t count) { append(std::basic_string_view<uint32_t>(str, count)); }
+
+	template <typename It> requires (!std::is_integral_v<It>)
+	void append(It first, It last) { append(std::basic_string<uint32_t>(first, last)); }
+
+	void push_back(uint32_t c) { insert(M_data.size(), 1, c); }
+
 	void pop_back()
 	{
 		M_data.pop_back();
-		M_data_changed = true;
+		M_layout.invalidate(M_data.size(), 1, 0);
+		shift_spans(M_data.size(), 1, 0);
+	}
+
+	void resize(std::size_t count, uint32_t c = 0)
+	{
+		if (count < M_data.size())
+			erase(count);
+		else
+			append(count - M_data.size(), c);
 	}
 
-	template <typename... Ts>
-	void append(Ts &&...args)
+	static constexpr std::size_t npos = code_point_view::npos;
+
+	// styles part of the text. Parts of other spans under it are replaced, characters outside every span use the text's colour, font and scale.
+	// Spans move along with edits, and characters inserted inside a span take its style. set_string keeps them as they are
+	// every span is drawn in the same batch as the rest of the text
+	void add_span(const text_span &span);
+	void clear_spans();
+	// sorted by begin, never overlapping
+	const std::vector<text_span> &get_spans() const { return M_spans; }
+
+	// wraps lines at word boundaries once they're wider than width. 0 disables wrapping
+	// width is in font pixels, so it doesn't take into account the text's scale
+	void set_max_width(float width) { M_layout.set_max_width(width); }
+	float get_max_width() const { return M_layout.get_max_width(); }
+
+	void set_alignment(text_align align) { M_layout.set_alignment(align); }
+	text_align get_alignment() const { return M_layout.get_alignment(); }
+
+	// distance between baselines, in multiples of the font's line spacing
+	void set_line_height(float height) { M_layout.set_line_height(height); }
+	float get_line_height() const { return M_layout.get_line_height(); }
+
+	// x of the caret in front of character pos, in the same space as get_local_rect
+	float get_caret_x(std::size_t pos) const
 	{
-		M_data.append(std::forward<Ts>(args)...);
-		M_data_changed = true;
+		update_bounds();
+		return layout().caret_x(pos) * M_scale.x;
 	}
 
-	template <typename... Ts>
-	void replace(Ts &&...args)
+	// index of the caret closest to x (in the same space as get_local_rect) on line
+	std::size_t get_index_at(std::size_t line, float x) const
 	{
-		M_data.replace(std::forward<Ts>(args)...);
-		M_data_changed = true;
+		update_bounds();
+		return layout().index_at(line, x / M_scale.x);
 	}
 
-	template <typename... Ts>
-	void resize(Ts... args)
+	const std::vector<line_box> &get_lines() const
 	{
-		M_data.resize(args...);
-		M_data_changed = true;
+		update_bounds();
+		return layout().lines();
 	}
 
 	void set_text_origin(vec3 origin) { M_origin = origin; }
@@ -220,7 +454,11 @@ public:
 	void set_angle(float angle) { M_angle = angle; }
 	float get_angle() const { return M_angle; }
 
-	void set_font(font &_font) noexcept { M_font = &_font; }
+	void set_font(font &_font) noexcept
+	{
+		M_font = &_font;
+		M_layout.invalidate();
+	}
 	font const *get_font() const noexcept { return M_font; }
 
 	/// @brief get's rect with local bounds of the text with the origin as (0,0). The minimum of the returned rect is not neccessarily (0,0).
@@ -230,7 +468,7 @@ public:
 
 	void draw_raw(const window *win, vec2 absolute_min) const override;
 private:
-	std::basic_string<uint32_t> M_data;
+	detail::compact_string M_data;
 	// M_bound doesn't take into account M_scale
 	mutable bound M_bound;
 	vec2 M_origin;
@@ -238,9 +476,24 @@ private:
 	vec2 M_scale;
 	float M_angle;
 	font *M_font;
-	mutable bool M_data_changed;
+	mutable paragraph_layout M_layout;
+	// set while the layout comes from the run cache, M_layout is kept empty meanwhile
+	mutable std::shared_ptr<const shaped_run> M_run;
+	std::vector<text_span> M_spans;
+	// generation of the fonts the layout was built with, see font_generation
+	mutable uint64_t M_generation;
+
+	// longer strings are usually edited rather than repeated, so they're laid out incrementally instead
+	static constexpr std::size_t max_shared_run = 256;
 
 	void update_bounds() const;
+	// changes whenever the metrics of the text's font or its spans' fonts can change (font::get_generation)
+	uint64_t font_generation() const;
+
+	void shift_spans(std::size_t pos, std::size_t removed, std::size_t inserted);
+	vec4 color_at(std::size_t pos) const;
+
+	const paragraph_layout &layout() const { return M_run ? M_run->layout : M_layout; }
 
 	void obj_init() override;
 
@@ -251,7 +504,10 @@ protected:
 		M_rot_origin{},
 		M_font{},
 		M_angle{},
-		M_data_changed{ true }
+		M_layout{},
+		M_run{},
+		M_spans{},
+		M_generation{}
 	{
 	}
 	text(font &_font) :
@@ -260,7 +516,10 @@ protected:
 		M_rot_origin{},
 		M_font{ &_font },
 		M_angle{},
-		M_data_changed{ true }
+		M_layout{},
+		M_run{},
+		M_spans{},
+		M_generation{}
 	{
 	}
 	text(std::basic_string_view<char> txt, font &_font) :
@@ -269,9 +528,13 @@ protected:
 		M_rot_origin{},
 		M_font{ &_font },
 		M_angle{},
-		M_data{ txt.begin(), txt.end() },
-		M_data_changed{ true }
+		M_data{},
+		M_layout{},
+		M_run{},
+		M_spans{},
+		M_generation{}
 	{
+		set_string(txt);
 	}
 
 	text(std::basic_string_view<wchar_t> txt, font &_font) :
@@ -280,19 +543,26 @@ protected:
 		M_rot_origin{},
 		M_font{ &_font },
 		M_angle{},
-		M_data{ txt.begin(), txt.end() },
-		M_data_changed{ true }
+		M_data{},
+		M_layout{},
+		M_run{},
+		M_spans{},
+		M_generation{}
 	{
+		set_string(txt);
 	}
 
-	text(std::basic_string_view<uint32_t> txt, font &_font) :
+	text(code_point_view txt, font &_font) :
 		M_origin{},
 		M_scale{ 1, 1 },
 		M_rot_origin{},
 		M_font{ &_font },
 		M_angle{},
-		M_data{ txt.begin(), txt.end() },
-		M_data_changed{ true }
+		M_data{ txt },
+		M_layout{},
+		M_run{},
+		M_spans{},
+		M_generation{}
 	{
 	}
 };
@@ -0,0 +1,258 @@
+#ifndef TEXT_LAYOUT_H
+#define TEXT_LAYOUT_H
+
+#include "macro.h"
+#include "math/vec.h"
+#include "utils/compact_string.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <span>
+#include <algorithm>
+#include <cstdint>
+
+SGUI_BEG
+
+class font;
+
+struct bound
+{
+	vec2 min;
+	vec2 dims;
+
+	vec2 max() const
+	{
+		return min + dims;
+	}
+};
+
+enum class text_align
+{
+	left,
+	center,
+	right,
+};
+
+// style of the characters in [begin, end) of a text
+struct text_span
+{
+	std::size_t begin;
+	std::size_t end;
+	vec4 color;
+	// null keeps the text's font
+	const font *fnt = nullptr;
+	// relative to the text's scale
+	float scale = 1;
+
+	// spans that only change the colour don't change where glyphs go
+	bool affects_layout() const { return fnt || scale != 1; }
+};
+
+// span containing pos in spans sorted by begin that don't overlap, null if there's none
+inline const text_span *find_span(std::span<const text_span> spans, std::size_t pos)
+{
+	auto it = std::upper_bound(spans.begin(), spans.end(), pos, [](std::size_t pos, const text_span &span) { return pos < span.begin; });
+	if (it == spans.begin() || (it - 1)->end <= pos)
+		return nullptr;
+	return &*(it - 1);
+}
+
+// a single laid out line of a paragraph
+// positions are in font pixels relative to the line's baseline, and the first glyph's left edge
+struct line_box
+{
+	// index of the first character of the line
+	std::size_t begin;
+	// one past the last character drawn on the line (excludes the newline, and spaces at a wrap)
+	std::size_t end;
+	// index of the first character of the next line
+	std::size_t next;
+
+	float width;
+	float min_y;
+	float max_y;
+
+	// horizontal offset of the first glyph, which is removed so the line starts at x = 0
+	float bearing;
+};
+
+// breaks a string into lines at word boundaries and caches the resulting line boxes
+// edits can be reported through invalidate(pos, removed, inserted), after which update only lays out the lines the edit touched.
+// The pen position and running extents of every character are kept, so edits at the end of a line (ex. appending or popping a character)
+// only lay out the edited characters, and the bounds are kept as running extents over the lines
+class paragraph_layout
+{
+public:
+	paragraph_layout() :
+		M_bound{},
+		M_max_width{},
+		M_line_height{ 1 },
+		M_line_advance{},
+		M_widest{},
+		M_align{ text_align::left },
+		M_dirty_begin{},
+		M_dirty_end{},
+		M_dirty_delta{},
+		M_valid_extents{},
+		M_dirty{ dirty_state::full },
+		M_dirty_bounds{ true }
+	{
+	}
+
+	// 0 disables wrapping. Width is in font pixels (not scaled)
+	void set_max_width(float width)
+	{
+		if (width != M_max_width)
+		{
+			M_max_width = width;
+			invalidate();
+		}
+	}
+	float get_max_width() const { return M_max_width; }
+
+	void set_alignment(text_align align)
+	{
+		M_align = align;
+		M_dirty_bounds = true;
+	}
+	text_align get_alignment() const { return M_align; }
+
+	// distance between baselines, in multiples of the font's line spacing
+	void set_line_height(float height)
+	{
+		M_line_height = height;
+		M_dirty_bounds = true;
+	}
+	float get_line_height() const { return M_line_height; }
+
+	// forces the whole paragraph to be laid out on the next update
+	void invalidate() { M_dirty = dirty_state::full; }
+
+	// reports that *removed* characters starting at pos were replaced by *inserted* characters
+	void invalidate(std::size_t pos, std::size_t removed, std::size_t inserted);
+
+	bool needs_update() const { return M_dirty != dirty_state::clean || M_dirty_bounds; }
+	// true if the next update lays out every line
+	bool needs_full_update() const { return M_dirty == dirty_state::full || (needs_update() && M_lines.empty()); }
+
+	// drops the laid out lines and per character data, the next update after an edit lays out everything again
+	void reset()
+	{
+		M_lines = {};
+		M_chars = {};
+		M_extents = {};
+		M_valid_extents = 0;
+		M_dirty = dirty_state::clean;
+		M_dirty_bounds = false;
+	}
+
+	// lays out any lines touched since the last update
+	// characters covered by spans are measured with the span's font and scale, spans have to be sorted by begin and not overlap.
+	// The distance between baselines fits the tallest font used
+	void update(const font &_font, code_point_view str, std::span<const text_span> spans = {});
+
+	const std::vector<line_box> &lines() const { return M_lines; }
+
+	// horizontal offset of a line due to alignment
+	float line_offset(const line_box &line) const;
+
+	// vertical distance between two baselines
+	float line_advance() const { return M_line_advance; }
+
+	// bounds of the laid out paragraph with the first baseline at y = 0
+	const bound &bounds() const { return M_bound; }
+
+	// index of the line that pos is on
+	std::size_t line_of(std::size_t pos) const;
+	// x of the caret in front of pos, relative to the paragraph
+	float caret_x(std::size_t pos) const;
+	// caret position on line closest to x, found by binary search over the pen positions
+	std::size_t index_at(std::size_t line, float x) const;
+
+private:
+	enum class dirty_state
+	{
+		clean,
+		partial,
+		full,
+	};
+
+	struct char_extent
+	{
+		// pen position after the character, relative to the start of its line
+		float pen;
+		// vertical extents of the characters of the line up to this one
+		float min_y;
+		float max_y;
+	};
+
+	struct line_extent
+	{
+		// running over every line up to this one, with the line's baseline offset applied
+		float widest;
+		float min_y;
+		float max_y;
+	};
+
+	// metrics of a character in font pixels, with its span's font and scale applied
+	struct glyph_box
+	{
+		vec2 offset;
+		vec2 size;
+		float advance;
+	};
+
+	struct glyph_source
+	{
+		const font &fnt;
+		std::span<const text_span> spans;
+
+		glyph_box at(code_point_view str, std::size_t i) const;
+	};
+
+	std::vector<line_box> M_lines;
+	std::vector<char_extent> M_chars;
+	std::vector<line_extent> M_extents;
+	bound M_bound;
+
+	float M_max_width;
+	float M_line_height;
+	float M_line_advance;
+	float M_widest;
+	text_align M_align;
+
+	// dirty range [M_dirty_begin, M_dirty_end) is in the coordinates of the current string
+	std::size_t M_dirty_begin;
+	std::size_t M_dirty_end;
+	std::ptrdiff_t M_dirty_delta;
+	// number of entries at the start of M_extents that are still valid
+	std::size_t M_valid_extents;
+	dirty_state M_dirty;
+	bool M_dirty_bounds;
+
+	// characters in [begin, resume) are known to be unchanged, so laying out continues from resume
+	line_box layout_line(const glyph_source &glyphs, code_point_view str, std::size_t begin, std::size_t resume, bool &newline);
+	void measure_line(const glyph_source &glyphs, code_point_view str, line_box &line) const;
+	float pen_before(const line_box &line, std::size_t pos) const;
+
+	// resume_begin is where the line holding the first edit started, before the edit
+	void layout_from(const glyph_source &glyphs, code_point_view str, std::size_t first_line, std::size_t resume_begin);
+	void update_bounds();
+};
+
+// a string laid out once, and shared by every text with the same font, layout settings and contents
+struct shaped_run
+{
+	detail::compact_string str;
+	paragraph_layout layout;
+	// pen of each character on its baseline, relative to the first baseline at a scale of 1, indexed like str
+	// the glyph's quad is found from it at draw time, since it depends on the subpixel variant the pen picks
+	std::vector<vec2> pens;
+	// keeps the face alive, so its address can't be reused by another face while the run is cached
+	std::shared_ptr<const void> face;
+};
+
+SGUI_END
+
+#endif
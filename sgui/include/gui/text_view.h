@@ -0,0 +1,97 @@
+#ifndef TEXT_VIEW_H
+#define TEXT_VIEW_H
+
+#include "macro.h"
+#include "gui/widget.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+SGUI_BEG
+
+class font;
+class window;
+
+// scrollable view over a large, append-only document (ex. a log tail)
+// lines are stored back to back as utf-8 with an index of where each one starts,
+// and only the lines inside of the view are decoded and drawn
+class text_view : public rectangle, public colorable
+{
+public:
+	static ptr_handle<text_view> make(font &_font)
+	{
+		return ptr_handle<text_view>(new text_view(_font));
+	}
+
+	static ptr_handle<text_view> make(vec2 min, vec2 dims, font &_font)
+	{
+		return ptr_handle<text_view>(new text_view(min, dims, _font));
+	}
+
+	virtual ~text_view() = default;
+
+	// appends utf-8 text as new lines, splitting at '\n'
+	void append_line(std::string_view line);
+	void clear();
+
+	std::size_t line_count() const { return M_starts.size() - M_first; }
+	// utf-8 contents of line i (without the newline)
+	std::string_view line(std::size_t i) const;
+
+	// oldest lines are dropped once there are more than count lines. 0 keeps every line
+	void set_max_lines(std::size_t count);
+	std::size_t get_max_lines() const { return M_max_lines; }
+
+	// first visible line (can be fractional)
+	void scroll_to(float line);
+	void scroll(float lines) { scroll_to(get_scroll() + lines); }
+	float get_scroll() const;
+
+	// keeps the last line at the bottom of the view as lines are appended
+	void set_follow_tail(bool follow) { M_follow_tail = follow; }
+	bool get_follow_tail() const { return M_follow_tail; }
+
+	// distance between baselines, in multiples of the font's line spacing
+	void set_line_height(float height) { M_line_height = height; }
+	float get_line_height() const { return M_line_height; }
+
+	void set_font(font &_font) noexcept { M_font = &_font; }
+	font const *get_font() const noexcept { return M_font; }
+
+	// number of lines that fit inside of the view
+	float visible_lines() const;
+
+	vec2 min() const override;
+	vec2 size() const override;
+
+	bool in_bounds(vec2 loc, vec2 absolute_min) const override;
+
+	void draw_raw(const window *win, vec2 absolute_min) const override;
+
+protected:
+	void obj_init() override;
+
+	text_view(font &_font) : M_first{}, M_max_lines{}, M_scroll{}, M_line_height{ 1 }, M_font{ &_font }, M_follow_tail{ true } {}
+	text_view(vec2 min, vec2 dims, font &_font) : rectangle(min, dims), M_first{}, M_max_lines{}, M_scroll{}, M_line_height{ 1 }, M_font{ &_font }, M_follow_tail{ true } {}
+
+private:
+	std::string M_bytes;
+	// byte offset of the start of each line. Lines before M_first have been dropped, and are compacted away in bulk
+	std::vector<std::size_t> M_starts;
+	std::size_t M_first;
+	std::size_t M_max_lines;
+
+	float M_scroll;
+	float M_line_height;
+	font *M_font;
+	bool M_follow_tail;
+
+	void push_line(std::string_view line);
+	void drop_lines(std::size_t count);
+	float line_advance() const;
+};
+
+SGUI_END
+
+#endif
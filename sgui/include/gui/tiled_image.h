@@ -0,0 +1,134 @@
+#ifndef TILED_IMAGE_H
+#define TILED_IMAGE_H
+
+#include "macro.h"
+#include "widget.h"
+#include "graphics/texture.h"
+#include "graphics/buffers.h"
+#include "graphics/tile_pyramid.h"
+
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+SGUI_BEG
+
+class window;
+
+// draws images of any size (ex. maps, floor plans much larger than GL_MAX_TEXTURE_SIZE), panned and zoomed
+// only the tiles visible at the current zoom are read, on worker threads, and uploaded into the slots of a fixed size cache texture.
+// A small indirection texture tells the fragment shader which slot, and which level, holds the tile under each pixel,
+// so tiles that haven't arrived yet are drawn from the nearest coarser level that has. Memory is bounded by the cache, whatever the image's size
+class tiled_image : public rectangle
+{
+public:
+	static ptr_handle<tiled_image> make(std::shared_ptr<const tile_source> source, vec2 min, vec2 dims)
+	{
+		return ptr_handle<tiled_image>(new tiled_image(std::move(source), min, dims));
+	}
+
+	virtual ~tiled_image();
+
+	vec2 min() const override;
+	vec2 size() const override;
+
+	bool in_bounds(vec2 loc, vec2 absolute_min) const override;
+
+	void draw_raw(const window *win, vec2 absolute_min) const override;
+
+	const tile_source &source() const;
+
+	// center is the image pixel drawn at the middle of the widget, counted from the image's top left. zoom is in screen pixels per image pixel
+	void set_view(vec2 center, float zoom);
+	vec2 view_center() const { return M_center; }
+	float zoom() const { return M_zoom; }
+
+	// moves the image by offset screen pixels
+	void pan(vec2 offset);
+	// zooms by factor, keeping the image pixel under point (relative to the widget's min) in place
+	void zoom_at(float factor, vec2 point);
+	// the whole image, centered
+	void fit();
+
+	// side of the cache texture in pixels, clamped to GL_MAX_TEXTURE_SIZE. Set it before setup, the default (4096) holds 225 tiles of 256 pixels,
+	// enough for a 2560x1440 widget. Tiles that don't fit in the cache are drawn from a coarser level
+	void set_cache_size(int size) { M_cache_size = size; }
+	int get_cache_size() const { return M_cache_size; }
+
+	// tiles uploaded per frame at most, 8 by default
+	void set_upload_budget(std::size_t tiles) { M_upload_budget = tiles; }
+
+	// called from a worker thread whenever a tile is ready to upload, glfwPostEmptyEvent by default so the window draws it without waiting for input
+	void set_ready_callback(std::function<void()> ready);
+
+	std::size_t resident_tiles() const { return M_resident.size(); }
+	std::size_t pending_tiles() const { return M_pending.size(); }
+
+protected:
+	void obj_init() override;
+
+	tiled_image(std::shared_ptr<const tile_source> source, vec2 min, vec2 dims);
+
+private:
+	struct request;
+	struct stream;
+
+	struct slot
+	{
+		// key of the tile the slot holds, none if it's free
+		uint64_t key;
+		uint64_t last_used;
+	};
+
+	static constexpr uint64_t no_tile = ~uint64_t{};
+	static constexpr uint32_t no_slot = ~uint32_t{};
+
+	vec2 M_center;
+	float M_zoom;
+	int M_cache_size;
+	std::size_t M_upload_budget;
+
+	// shared with the workers, which can outlive the widget
+	std::shared_ptr<stream> M_stream;
+
+	mutable texture M_cache;
+	// one rgba texel per tile of the first level: x and y of the slot, level of the tile the slot holds, and 255 if there's one
+	mutable texture M_pages;
+	mutable std::vector<unsigned char> M_page_data;
+	mutable bool M_pages_dirty;
+	// level drawn at the current zoom when the pages were last built
+	mutable uint32_t M_pages_level;
+
+	mutable std::vector<slot> M_slots;
+	uint32_t M_slots_per_row;
+	mutable std::unordered_map<uint64_t, uint32_t> M_resident;
+	mutable std::unordered_map<uint64_t, std::shared_ptr<request>> M_pending;
+	mutable uint64_t M_frame;
+	// the single tile of the last level, which is never evicted so there's always something to draw
+	uint64_t M_root;
+
+	vbo M_vbo;
+	vbo M_image_vbo;
+	vao M_vao;
+
+	// streams the tiles visible at the current view, and uploads the ones that are ready
+	void update() const;
+	void request_tile(uint64_t key) const;
+	bool upload_tile(const request &ready) const;
+	// free slot, or the least recently used one that the current frame doesn't use. no_slot if there's none
+	uint32_t find_slot() const;
+	// fills the pages with the resident tiles of finest_level and the coarser ones, finer tiles overriding coarser ones
+	void rebuild_pages(uint32_t finest_level) const;
+
+	static uint64_t make_key(uint32_t level, uint32_t column, uint32_t row)
+	{
+		return uint64_t{ level } << 48 | uint64_t{ row } << 24 | column;
+	}
+};
+
+SGUI_END
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef COMPACT_STRING_H
+#define COMPACT_STRING_H
+
+#include "macro.h"
+
+#include <string>
+#include <string_view>
+#include <iterator>
+#include <algorithm>
+#include <compare>
+#include <cstring>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+
+SGUI_BEG
+
+DETAIL_BEG
+
+inline uint32_t load_code_point(const unsigned char *data, uint8_t width, std::size_t i)
+{
+	switch (width)
+	{
+	case 1:
+		return data[i];
+	case 2:
+	{
+		uint16_t res;
+		std::memcpy(&res, data + 2 * i, 2);
+		return res;
+	}
+	default:
+	{
+		uint32_t res;
+		std::memcpy(&res, data + 4 * i, 4);
+		return res;
+	}
+	}
+}
+
+inline void store_code_point(unsigned char *data, uint8_t width, std::size_t i, uint32_t c)
+{
+	switch (width)
+	{
+	case 1:
+		data[i] = static_cast<unsigned char>(c);
+		break;
+	case 2:
+	{
+		auto value = static_cast<uint16_t>(c);
+		std::memcpy(data + 2 * i, &value, 2);
+		break;
+	}
+	default:
+		std::memcpy(data + 4 * i, &c, 4);
+		break;
+	}
+}
+
+DETAIL_END
+
+// read only view over code points stored 1, 2 or 4 bytes each
+// a std::basic_string_view<uint32_t> converts to it, so functions taking a view take utf-32 strings as well
+class code_point_view
+{
+public:
+	static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+	class iterator
+	{
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = uint32_t;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = uint32_t;
+
+		iterator() : M_data{}, M_pos{}, M_width{ 4 } {}
+		iterator(const unsigned char *data, uint8_t width, std::size_t pos) : M_data{ data }, M_pos{ pos }, M_width{ width } {}
+
+		uint32_t operator*() const { return detail::load_code_point(M_data, M_width, M_pos); }
+		uint32_t operator[](difference_type i) const { return detail::load_code_point(M_data, M_width, M_pos + i); }
+
+		iterator &operator++() { ++M_pos; return *this; }
+		iterator &operator--() { --M_pos; return *this; }
+		iterator operator++(int) { auto res = *this; ++M_pos; return res; }
+		iterator operator--(int) { auto res = *this; --M_pos; return res; }
+
+		iterator &operator+=(difference_type n) { M_pos += n; return *this; }
+		iterator &operator-=(difference_type n) { M_pos -= n; return *this; }
+
+		friend iterator operator+(iterator it, difference_type n) { return it += n; }
+		friend iterator operator+(difference_type n, iterator it) { return it += n; }
+		friend iterator operator-(iterator it, difference_type n) { return it -= n; }
+		friend difference_type operator-(const iterator &a, const iterator &b) { return static_cast<difference_type>(a.M_pos) - static_cast<difference_type>(b.M_pos); }
+
+		friend bool operator==(const iterator &a, const iterator &b) { return a.M_pos == b.M_pos; }
+		friend auto operator<=>(const iterator &a, const iterator &b) { return a.M_pos <=> b.M_pos; }
+
+		// index of the code point the iterator is at
+		std::size_t index() const { return M_pos; }
+
+	private:
+		const unsigned char *M_data;
+		std::size_t M_pos;
+		uint8_t M_width;
+	};
+
+	using const_iterator = iterator;
+	using value_type = uint32_t;
+	using size_type = std::size_t;
+
+	code_point_view() : M_data{}, M_size{}, M_width{ 4 } {}
+	code_point_view(const void *data, std::size_t size, uint8_t width) : M_data{ static_cast<const unsigned char *>(data) }, M_size{ size }, M_width{ width } {}
+
+	code_point_view(std::basic_string_view<uint32_t> str) : M_data{ reinterpret_cast<const unsigned char *>(str.data()) }, M_size{ str.size() }, M_width{ 4 } {}
+	code_point_view(const std::basic_string<uint32_t> &str) : code_point_view(std::basic_string_view<uint32_t>(str)) {}
+
+	std::size_t size() const { return M_size; }
+	bool empty() const { return !M_size; }
+	// bytes per code point
+	uint8_t width() const { return M_width; }
+	const unsigned char *data() const { return M_data; }
+
+	uint32_t operator[](std::size_t i) const { return detail::load_code_point(M_data, M_width, i); }
+	uint32_t front() const { return (*this)[0]; }
+	uint32_t back() const { return (*this)[M_size - 1]; }
+
+	iterator begin() const { return { M_data, M_width, 0 }; }
+	iterator end() const { return { M_data, M_width, M_size }; }
+	iterator cbegin() const { return begin(); }
+	iterator cend() const { return end(); }
+
+	code_point_view substr(std::size_t pos, std::size_t count = npos) const
+	{
+		pos = std::min(pos, M_size);
+		return { M_data + pos * M_width, std::min(count, M_size - pos), M_width };
+	}
+
+	std::basic_string<uint32_t> str() const { return { begin(), end() }; }
+	// text::get_string used to return the string itself, so code that copies it still compiles
+	operator std::basic_string<uint32_t>() const { return str(); }
+
+	friend bool operator==(const code_point_view &a, const code_point_view &b)
+	{
+		if (a.M_size != b.M_size)
+			return false;
+		if (a.M_width == b.M_width)
+			return !a.M_size || !std::memcmp(a.M_data, b.M_data, a.M_size * a.M_width);
+		return std::equal(a.begin(), a.end(), b.begin());
+	}
+
+private:
+	const unsigned char *M_data;
+	std::size_t M_size;
+	uint8_t M_width;
+};
+
+DETAIL_BEG
+
+// code point string that stores every code point with the width of the widest one: 1 byte while they're all below 256, 2 below 65536, and 4 otherwise
+// indexing stays O(1), which utf-8 can't do, and short strings are kept inline without allocating
+// edits never narrow the string, only assign picks the narrowest width again
+class compact_string
+{
+public:
+	static constexpr std::size_t npos = code_point_view::npos;
+	static constexpr std::size_t inline_bytes = 16;
+
+	compact_string() noexcept : M_size{}, M_capacity{ inline_bytes }, M_width{ 1 }, M_heap{} {}
+	compact_string(code_point_view str) : compact_string() { assign(str); }
+
+	compact_string(const compact_string &other) : compact_string() { assign(other.view()); }
+	compact_string &operator=(const compact_string &other)
+	{
+		if (this != &other)
+			assign(other.view());
+		return *this;
+	}
+
+	compact_string(compact_string &&other) noexcept : M_size{ other.M_size }, M_capacity{ other.M_capacity }, M_width{ other.M_width }, M_heap{ other.M_heap }
+	{
+		if (M_heap)
+			M_ptr = other.M_ptr;
+		else
+			std::memcpy(M_inline, other.M_inline, inline_bytes);
+
+		other.M_size = 0;
+		other.M_capacity = inline_bytes;
+		other.M_width = 1;
+		other.M_heap = false;
+	}
+	compact_string &operator=(compact_string &&other) noexcept
+	{
+		if (this != &other)
+		{
+			this->~compact_string();
+			new (this) compact_string(std::move(other));
+		}
+		return *this;
+	}
+
+	~compact_string()
+	{
+		if (M_heap)
+			delete[] M_ptr;
+	}
+
+	code_point_view view() const { return { data(), M_size, M_width }; }
+	operator code_point_view() const { return view(); }
+
+	std::size_t size() const { return M_size; }
+	bool empty() const { return !M_size; }
+	uint8_t width() const { return M_width; }
+	// bytes used on the heap, 0 while the string is inline
+	std::size_t heap_bytes() const { return M_heap ? M_capacity : 0; }
+
+	uint32_t operator[](std::size_t i) const { return load_code_point(data(), M_width, i); }
+
+	void assign(code_point_view str)
+	{
+		if (overlaps(str))
+		{
+			compact_string copy(str);
+			*this = std::move(copy);
+			return;
+		}
+
+		M_size = 0;
+		M_width = width_of(str);
+		replace(0, 0, str);
+	}
+
+	void clear() { M_size = 0; }
+
+	// replaces count code points starting at pos with str
+	void replace(std::size_t pos, std::size_t count, code_point_view str)
+	{
+		if (overlaps(str))
+		{
+			compact_string copy(str);
+			replace(pos, count, copy.view());
+			return;
+		}
+
+		pos = std::min<std::size_t>(pos, M_size);
+		make_gap(pos, count, str.size(), width_of(str));
+
+		if (str.empty())
+			return;
+
+		if (str.width() == M_width)
+			std::memcpy(data() + pos * M_width, str.data(), str.size() * M_width);
+		else
+			for (std::size_t i = 0; i < str.size(); ++i)
+				store_code_point(data(), M_width, pos + i, str[i]);
+	}
+
+	// replaces count code points starting at pos with n copies of c
+	void replace(std::size_t pos, std::size_t count, std::size_t n, uint32_t c)
+	{
+		pos = std::min<std::size_t>(pos, M_size);
+		make_gap(pos, count, n, width_of(c));
+
+		for (std::size_t i = 0; i < n; ++i)
+			store_code_point(data(), M_width, pos + i, c);
+	}
+
+	void insert(std::size_t pos, code_point_view str) { replace(pos, 0, str); }
+	void insert(std::size_t pos, std::size_t n, uint32_t c) { replace(pos, 0, n, c); }
+	void erase(std::size_t pos = 0, std::size_t count = npos) { replace(pos, count, code_point_view()); }
+	void append(code_point_view str) { replace(M_size, 0, str); }
+	void append(std::size_t n, uint32_t c) { replace(M_size, 0, n, c); }
+	void push_back(uint32_t c) { replace(M_size, 0, 1, c); }
+	void pop_back() { --M_size; }
+
+	void resize(std::size_t count, uint32_t c = 0)
+	{
+		if (count <= M_size)
+			M_size = static_cast<uint32_t>(count);
+		else
+			append(count - M_size, c);
+	}
+
+private:
+	union
+	{
+		unsigned char M_inline[inline_bytes];
+		unsigned char *M_ptr;
+	};
+
+	uint32_t M_size;
+	// in bytes
+	uint32_t M_capacity;
+	uint8_t M_width;
+	bool M_heap;
+
+	unsigned char *data() { return M_heap ? M_ptr : M_inline; }
+	const unsigned char *data() const { return M_heap ? M_ptr : M_inline; }
+
+	static uint8_t width_of(uint32_t c)
+	{
+		return c < 0x100 ? 1 : c < 0x10000 ? 2 : 4;
+	}
+
+	static uint8_t width_of(code_point_view str)
+	{
+		if (str.width() == 1)
+			return 1;
+
+		uint32_t widest = 0;
+		for (uint32_t c : str)
+			widest |= c;
+		return width_of(widest);
+	}
+
+	bool overlaps(code_point_view str) const
+	{
+		auto *begin = data();
+		return !str.empty() && str.data() < begin + M_capacity && str.data() + str.size() * str.width() > begin;
+	}
+
+	void reserve(std::size_t bytes, uint8_t width)
+	{
+		if (bytes <= M_capacity && width == M_width)
+			return;
+
+		std::size_t capacity = std::max<std::size_t>(bytes, M_capacity);
+		if (bytes > M_capacity)
+			capacity = std::max<std::size_t>(bytes, 2 * static_cast<std::size_t>(M_capacity));
+
+		auto *res = new unsigned char[capacity];
+
+		if (width == M_width)
+			std::memcpy(res, data(), M_size * M_width);
+		else
+			for (std::size_t i = 0; i < M_size; ++i)
+				store_code_point(res, width, i, (*this)[i]);
+
+		if (M_heap)
+			delete[] M_ptr;
+
+		M_ptr = res;
+		M_heap = true;
+		M_capacity = static_cast<uint32_t>(capacity);
+		M_width = width;
+	}
+
+	// replaces removed code points at pos with inserted uninitialized ones, widening the string to at least width
+	void make_gap(std::size_t pos, std::size_t removed, std::size_t inserted, uint8_t width)
+	{
+		removed = std::min<std::size_t>(removed, M_size - pos);
+		width = std::max(width, M_width);
+
+		std::size_t size = M_size - removed + inserted;
+		// the old code points are widened before the gap is made, so there has to be room for both
+		std::size_t bytes = std::max<std::size_t>(size, M_size) * width;
+
+		if (width != M_width && !M_heap && bytes <= inline_bytes)
+		{
+			// widen inline, from the back so nothing is overwritten before it's read
+			for (std::size_t i = M_size; i-- > 0;)
+				store_code_point(M_inline, width, i, (*this)[i]);
+			M_width = width;
+		}
+		else
+			reserve(bytes, width);
+
+		auto *d = data();
+		std::memmove(d + (pos + inserted) * M_width, d + (pos + removed) * M_width, (M_size - pos - removed) * M_width);
+
+		M_size = static_cast<uint32_t>(size);
+	}
+};
+
+DETAIL_END
+
+SGUI_END
+
+#endif
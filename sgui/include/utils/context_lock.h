@@ -75,6 +75,21 @@ private:
 	GLuint prev;
 };
 
+template <>
+class context_lock<GL_PIXEL_UNPACK_BUFFER_BINDING>
+{
+public:
+	context_lock() : prev{}
+	{
+		glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, (int *)&prev);
+	}
+	~context_lock()
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, prev);
+	}
+private:
+	GLuint prev;
+};
 
 // make sure ebo lock is declared before a vao lock, if neccessary
 // if declared after, then the ebo lock will destruct before the vao lock, and will unbind the ebo from the vao
@@ -199,6 +214,43 @@ private:
 	int prev_mode;
 };
 
+template <>
+class context_lock<GL_SCISSOR_TEST>
+{
+public:
+	context_lock() : prev_state{}, prev_box{}
+	{
+		glGetBooleanv(GL_SCISSOR_TEST, &prev_state);
+		glGetIntegerv(GL_SCISSOR_BOX, prev_box);
+	}
+	~context_lock()
+	{
+		glScissor(prev_box[0], prev_box[1], prev_box[2], prev_box[3]);
+		if (prev_state)
+			glEnable(GL_SCISSOR_TEST);
+		else
+			glDisable(GL_SCISSOR_TEST);
+	}
+private:
+	GLboolean prev_state;
+	int prev_box[4];
+};
+
+template <>
+class context_lock<GL_UNPACK_ALIGNMENT>
+{
+public:
+	context_lock() : prev{}
+	{
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &prev);
+	}
+	~context_lock()
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, prev);
+	}
+private:
+	int prev;
+};
 
 using shader_lock = context_lock<GL_CURRENT_PROGRAM>;
 using texture_lock = context_lock<GL_TEXTURE_BINDING_2D>;
@@ -211,6 +263,9 @@ using blend_lock = context_lock<GL_BLEND>;
 using viewport_lock = context_lock<GL_VIEWPORT>;
 using line_width_lock = context_lock<GL_LINE_WIDTH>;
 using cull_face_lock = context_lock<GL_CULL_FACE>;
+using scissor_lock = context_lock<GL_SCISSOR_TEST>;
+using unpack_alignment_lock = context_lock<GL_UNPACK_ALIGNMENT>;
+using pbo_lock = context_lock<GL_PIXEL_UNPACK_BUFFER_BINDING>;
 
 //inline constexpr int DRAW_LOCK = 0;
 //template <>
@@ -251,6 +306,9 @@ inline constexpr GLenum binding<GL_FRAMEBUFFER> = GL_FRAMEBUFFER_BINDING;
 template <>
 inline constexpr GLenum binding<GL_RENDERBUFFER> = GL_RENDERBUFFER_BINDING;
 
+template <>
+inline constexpr GLenum binding<GL_PIXEL_UNPACK_BUFFER> = GL_PIXEL_UNPACK_BUFFER_BINDING;
+
 
 DETAIL_END
 
@@ -21,6 +21,7 @@ enum class error_code
 	freetype_invalid_character,
 	freetype_font_failure,
 	invalid_argument,
+	invalid_encoding,
 	uknown_error,
 };
 
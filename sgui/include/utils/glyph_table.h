@@ -0,0 +1,151 @@
+#ifndef GLYPH_TABLE_H
+#define GLYPH_TABLE_H
+
+#include "macro.h"
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+SGUI_BEG
+
+DETAIL_BEG
+
+// direct-indexed codepoint -> T map
+// codepoints in [0, page_size) (basic latin/latin-1) live in a flat array that is always allocated,
+// the rest of unicode goes through a two-level table of lazily allocated pages
+// values never move once inserted, so pointers stay valid until clear()
+// find is lock free and may run on any number of threads while one thread at a time inserts:
+// a value is published by setting its present bit with release ordering, after it's initialized, and pages are published the same way.
+// clear and the destructor need every other thread to be done with the table
+template <typename T>
+class glyph_table
+{
+public:
+	static constexpr uint32_t page_bits = 8;
+	static constexpr uint32_t page_size = 1u << page_bits;
+	static constexpr uint32_t max_codepoint = 0x110000;
+	static constexpr uint32_t page_count = max_codepoint >> page_bits;
+
+	glyph_table() : M_dense{ std::make_unique<page>() }, M_directory{}, M_size{} {}
+
+	~glyph_table()
+	{
+		clear_directory();
+	}
+
+	glyph_table(const glyph_table &) = delete;
+	glyph_table &operator=(const glyph_table &) = delete;
+
+	// returns nullptr if c hasn't been inserted
+	T *find(uint32_t c) const
+	{
+		c = fold(c);
+
+		if (c < page_size)
+			return M_dense->find(c);
+
+		auto *directory = M_directory.load(std::memory_order_acquire);
+		if (!directory)
+			return nullptr;
+
+		page *p = directory[c >> page_bits].load(std::memory_order_acquire);
+		if (!p)
+			return nullptr;
+
+		return p->find(c & (page_size - 1));
+	}
+
+	// returns the value for c, calling init(T &) on a default constructed value first if c wasn't present
+	// only one thread may insert at a time
+	template <typename F>
+	T &find_or_insert(uint32_t c, F &&init)
+	{
+		c = fold(c);
+
+		page *p;
+		uint32_t i;
+
+		if (c < page_size)
+		{
+			p = M_dense.get();
+			i = c;
+		}
+		else
+		{
+			auto *directory = M_directory.load(std::memory_order_relaxed);
+			if (!directory)
+			{
+				directory = new std::atomic<page *>[page_count]{};
+				M_directory.store(directory, std::memory_order_release);
+			}
+
+			auto &slot = directory[c >> page_bits];
+			p = slot.load(std::memory_order_relaxed);
+			if (!p)
+			{
+				p = new page();
+				slot.store(p, std::memory_order_release);
+			}
+
+			i = c & (page_size - 1);
+		}
+
+		if (auto *res = p->find(i))
+			return *res;
+
+		init(p->values[i]);
+		p->present[i / 64].fetch_or(uint64_t{ 1 } << (i % 64), std::memory_order_release);
+		M_size.store(M_size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+		return p->values[i];
+	}
+
+	void clear()
+	{
+		M_dense = std::make_unique<page>();
+		clear_directory();
+		M_size.store(0, std::memory_order_relaxed);
+	}
+
+	std::size_t size() const { return M_size.load(std::memory_order_relaxed); }
+
+private:
+	struct page
+	{
+		T values[page_size];
+		std::atomic<uint64_t> present[page_size / 64] = {};
+
+		T *find(uint32_t i)
+		{
+			return present[i / 64].load(std::memory_order_acquire) & (uint64_t{ 1 } << (i % 64)) ? &values[i] : nullptr;
+		}
+	};
+
+	std::unique_ptr<page> M_dense;
+	std::atomic<std::atomic<page *> *> M_directory;
+	std::atomic<std::size_t> M_size;
+
+	void clear_directory()
+	{
+		auto *directory = M_directory.exchange(nullptr, std::memory_order_relaxed);
+		if (!directory)
+			return;
+
+		for (uint32_t i = 0; i < page_count; ++i)
+			delete directory[i].load(std::memory_order_relaxed);
+		delete[] directory;
+	}
+
+	// codepoints outside of unicode share the slot of U+0000, which freetype maps to .notdef anyways
+	static constexpr uint32_t fold(uint32_t c)
+	{
+		return c < max_codepoint ? c : 0;
+	}
+};
+
+DETAIL_END
+
+SGUI_END
+
+#endif
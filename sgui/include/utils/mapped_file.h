@@ -0,0 +1,72 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "macro.h"
+
+#include <string>
+#include <new>
+#include <utility>
+#include <cstddef>
+
+SGUI_BEG
+
+DETAIL_BEG
+
+// read only memory mapping of a whole file
+// pages are read by the os as they're touched, so nothing is copied into a buffer of ours
+class mapped_file
+{
+public:
+	// how the file is going to be read, so the os reads ahead or not
+	enum class access_pattern
+	{
+		// the whole file, read ahead as soon as it's mapped
+		sequential,
+		// small parts of a file that can be much larger than memory (ex. tiles), only the touched pages are read
+		random
+	};
+
+	mapped_file() noexcept : M_data{}, M_size{}, M_open{} {}
+	explicit mapped_file(const std::string &file_name, access_pattern access = access_pattern::sequential) : mapped_file() { open(file_name, access); }
+
+	~mapped_file() { close(); }
+
+	mapped_file(const mapped_file &) = delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	mapped_file(mapped_file &&other) noexcept : M_data{ other.M_data }, M_size{ other.M_size }, M_open{ other.M_open }
+	{
+		other.M_data = nullptr;
+		other.M_size = 0;
+		other.M_open = false;
+	}
+
+	mapped_file &operator=(mapped_file &&other) noexcept
+	{
+		if (this != &other)
+		{
+			close();
+			new (this) mapped_file(std::move(other));
+		}
+		return *this;
+	}
+
+	// returns false if the file couldn't be opened or mapped. Empty files open, with a null data()
+	bool open(const std::string &file_name, access_pattern access = access_pattern::sequential);
+	void close();
+
+	bool is_open() const { return M_open; }
+	const unsigned char *data() const { return M_data; }
+	std::size_t size() const { return M_size; }
+
+private:
+	const unsigned char *M_data;
+	std::size_t M_size;
+	bool M_open;
+};
+
+DETAIL_END
+
+SGUI_END
+
+#endif
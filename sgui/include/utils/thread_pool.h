@@ -0,0 +1,48 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "macro.h"
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <cstddef>
+
+SGUI_BEG
+
+// fixed set of worker threads running queued tasks in the order they were submitted
+// the destructor drops tasks that haven't started, and waits for the running ones
+class thread_pool
+{
+public:
+	// 0 picks one thread less than the hardware has (at least one), leaving a core to the thread that owns the OpenGL context
+	explicit thread_pool(unsigned int threads = 0);
+	~thread_pool();
+
+	thread_pool(const thread_pool &) = delete;
+	thread_pool &operator=(const thread_pool &) = delete;
+
+	void submit(std::function<void()> task);
+
+	// runs body(first, last) over ranges of [begin, end) of at least grain items, on the workers and the calling thread, and returns once they're all done
+	// the calling thread takes ranges like the workers, so it's safe to call from a task of the same pool, even with every worker busy
+	void parallel_for(std::size_t begin, std::size_t end, const std::function<void(std::size_t, std::size_t)> &body, std::size_t grain = 1);
+
+	unsigned int size() const { return static_cast<unsigned int>(M_threads.size()); }
+
+private:
+	std::vector<std::thread> M_threads;
+	std::deque<std::function<void()>> M_tasks;
+	std::mutex M_mutex;
+	std::condition_variable M_wake;
+	bool M_stop;
+
+	void work();
+};
+
+SGUI_END
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef UTF_H
+#define UTF_H
+
+#include "macro.h"
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+SGUI_BEG
+
+DETAIL_BEG
+
+inline constexpr uint32_t replacement_character = 0xFFFD;
+
+// decodes the utf-8 sequence starting at it, and moves it past the sequence
+// malformed sequences decode to U+FFFD and consume a single byte
+inline uint32_t decode_utf8(const char *&it, const char *end)
+{
+	auto byte = [](const char *p) { return static_cast<unsigned char>(*p); };
+
+	uint32_t lead = byte(it);
+
+	if (lead < 0x80)
+	{
+		++it;
+		return lead;
+	}
+
+	int length;
+	uint32_t c;
+	uint32_t min;
+
+	if ((lead & 0xE0) == 0xC0)
+	{
+		length = 2;
+		c = lead & 0x1F;
+		min = 0x80;
+	}
+	else if ((lead & 0xF0) == 0xE0)
+	{
+		length = 3;
+		c = lead & 0x0F;
+		min = 0x800;
+	}
+	else if ((lead & 0xF8) == 0xF0)
+	{
+		length = 4;
+		c = lead & 0x07;
+		min = 0x10000;
+	}
+	else
+	{
+		++it;
+		return replacement_character;
+	}
+
+	if (end - it < length)
+	{
+		++it;
+		return replacement_character;
+	}
+
+	for (int i = 1; i < length; ++i)
+	{
+		uint32_t cont = byte(it + i);
+		if ((cont & 0xC0) != 0x80)
+		{
+			++it;
+			return replacement_character;
+		}
+		c = (c << 6) | (cont & 0x3F);
+	}
+
+	// overlong encodings, surrogates and values past the end of unicode
+	if (c < min || (c >= 0xD800 && c < 0xE000) || c > 0x10FFFF)
+	{
+		++it;
+		return replacement_character;
+	}
+
+	it += length;
+	return c;
+}
+
+// appends the code points of str to out. Malformed sequences are replaced by U+FFFD, in which case false is returned
+bool decode_utf8(std::string_view str, std::basic_string<uint32_t> &out);
+
+// same as decode_utf8, but for wide strings (utf-16 where wchar_t is 2 bytes, utf-32 otherwise)
+bool decode_wide(std::wstring_view str, std::basic_string<uint32_t> &out);
+
+DETAIL_END
+
+SGUI_END
+
+#endif
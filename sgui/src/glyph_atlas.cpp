@@ -0,0 +1,239 @@
+#include "graphics/glyph_atlas.h"
+
+#include "utils/context_lock.h"
+
+#include <algorithm>
+
+SGUI_BEG
+
+DETAIL_BEG
+
+struct atlas_cache
+{
+	// every page of every atlas, for the global budget
+	std::vector<atlas_page *> pages;
+	std::size_t budget = 64 * 1024 * 1024;
+	glyph_cache_stats stats{};
+	uint64_t batch = 1;
+
+	static atlas_cache &get()
+	{
+		static atlas_cache res;
+		return res;
+	}
+};
+
+glyph_atlas::glyph_atlas(unsigned int glyph_height) : M_budget{}, M_page_dim{ 256 }, M_stats{}
+{
+	// room for a few hundred glyphs per page
+	while (M_page_dim < 2048 && M_page_dim < static_cast<int>(glyph_height) * 12)
+		M_page_dim *= 2;
+}
+
+glyph_atlas::~glyph_atlas()
+{
+	clear();
+}
+
+void glyph_atlas::clear()
+{
+	auto &cache = atlas_cache::get();
+
+	std::erase_if(cache.pages, [this](atlas_page *page) { return page->owner == this; });
+
+	cache.stats.bytes -= M_stats.bytes;
+	cache.stats.pages -= M_stats.pages;
+	cache.stats.glyphs -= M_stats.glyphs;
+
+	M_stats.bytes = 0;
+	M_stats.pages = 0;
+	M_stats.glyphs = 0;
+
+	M_pages.clear();
+}
+
+void glyph_atlas::insert(atlas_slot &slot, const unsigned char *pixels, int width, int height, int pitch)
+{
+	ivec2 pos;
+	auto *page = allocate(width + 2 * padding, height + 2 * padding, pos);
+
+	// copy with a cleared border, so linear filtering never picks up a neighbouring glyph
+	static std::vector<unsigned char> scratch;
+
+	int padded_width = width + 2 * padding;
+	scratch.assign(static_cast<std::size_t>(padded_width) * (height + 2 * padding), 0);
+
+	for (int y = 0; y < height; ++y)
+	{
+		auto *row = pixels + static_cast<std::ptrdiff_t>(y) * pitch;
+		std::copy(row, row + width, scratch.data() + static_cast<std::size_t>(y + padding) * padded_width + padding);
+	}
+
+	{
+		detail::unpack_alignment_lock lock;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		page->text.sub_image(pos.x, pos.y, padded_width, height + 2 * padding, GL_RED, scratch.data());
+	}
+
+	slot.page = page;
+	slot.pos = pos + ivec2(padding, padding);
+	page->slots.push_back(&slot);
+	touch(page);
+
+	auto &cache = atlas_cache::get();
+
+	++M_stats.glyphs;
+	++M_stats.rasterizations;
+	++cache.stats.glyphs;
+	++cache.stats.rasterizations;
+}
+
+void glyph_atlas::begin_batch()
+{
+	++atlas_cache::get().batch;
+}
+
+uint64_t glyph_atlas::current_batch()
+{
+	return atlas_cache::get().batch;
+}
+
+void glyph_atlas::set_global_budget(std::size_t bytes)
+{
+	atlas_cache::get().budget = bytes;
+}
+
+std::size_t glyph_atlas::get_global_budget()
+{
+	return atlas_cache::get().budget;
+}
+
+const glyph_cache_stats &glyph_atlas::global_stats()
+{
+	return atlas_cache::get().stats;
+}
+
+atlas_page *glyph_atlas::allocate(int width, int height, ivec2 &pos)
+{
+	// only the newest page is filled, so older pages go cold and can be evicted
+	if (!M_pages.empty() && fit(*M_pages.back(), width, height, pos))
+		return M_pages.back().get();
+
+	int dim = M_page_dim;
+	while (dim < width || dim < height)
+		dim *= 2;
+
+	make_room(static_cast<std::size_t>(dim) * dim);
+
+	auto *page = new_page(dim);
+	fit(*page, width, height, pos);
+
+	return page;
+}
+
+atlas_page *glyph_atlas::new_page(int dim)
+{
+	auto page = std::make_unique<atlas_page>();
+	page->dim = dim;
+	page->owner = this;
+	page->last_used = current_batch();
+
+	// glyphs are drawn at their size, so they're never minified and a single level is enough
+	page->text.allocate({ .format = GL_RED, .mag_filter = GL_LINEAR }, dim, dim);
+
+	auto &cache = atlas_cache::get();
+	cache.pages.push_back(page.get());
+
+	M_stats.bytes += page->bytes();
+	++M_stats.pages;
+	cache.stats.bytes += page->bytes();
+	++cache.stats.pages;
+
+	M_pages.push_back(std::move(page));
+	return M_pages.back().get();
+}
+
+bool glyph_atlas::fit(atlas_page &page, int width, int height, ivec2 &pos) const
+{
+	for (auto &shelf : page.shelves)
+	{
+		if (height <= shelf.height && shelf.x + width <= page.dim)
+		{
+			pos = { shelf.x, shelf.y };
+			shelf.x += width;
+			return true;
+		}
+	}
+
+	int y = page.shelves.empty() ? 0 : page.shelves.back().y + page.shelves.back().height;
+	if (y + height > page.dim || width > page.dim)
+		return false;
+
+	page.shelves.push_back({ .y = y, .height = height, .x = width });
+	pos = { 0, y };
+
+	return true;
+}
+
+void glyph_atlas::make_room(std::size_t bytes)
+{
+	auto batch = current_batch();
+	auto evictable = [batch](const atlas_page *page) { return page->last_used != batch; };
+	auto older = [](const atlas_page *a, const atlas_page *b) { return a->last_used < b->last_used; };
+
+	while (M_budget && M_stats.bytes + bytes > M_budget)
+	{
+		atlas_page *victim = nullptr;
+		for (auto &page : M_pages)
+			if (evictable(page.get()) && (!victim || older(page.get(), victim)))
+				victim = page.get();
+
+		if (!victim)
+			break;
+		evict(victim);
+	}
+
+	auto &cache = atlas_cache::get();
+	while (cache.budget && cache.stats.bytes + bytes > cache.budget)
+	{
+		atlas_page *victim = nullptr;
+		for (auto *page : cache.pages)
+			if (evictable(page) && (!victim || older(page, victim)))
+				victim = page;
+
+		if (!victim)
+			break;
+		evict(victim);
+	}
+}
+
+void glyph_atlas::evict(atlas_page *page)
+{
+	auto &cache = atlas_cache::get();
+	auto *owner = page->owner;
+
+	for (auto *slot : page->slots)
+		slot->page = nullptr;
+
+	std::size_t glyphs = page->slots.size();
+
+	owner->M_stats.bytes -= page->bytes();
+	--owner->M_stats.pages;
+	owner->M_stats.glyphs -= glyphs;
+	++owner->M_stats.evicted_pages;
+	owner->M_stats.evicted_glyphs += glyphs;
+
+	cache.stats.bytes -= page->bytes();
+	--cache.stats.pages;
+	cache.stats.glyphs -= glyphs;
+	++cache.stats.evicted_pages;
+	cache.stats.evicted_glyphs += glyphs;
+
+	std::erase(cache.pages, page);
+	std::erase_if(owner->M_pages, [page](const auto &cur) { return cur.get() == page; });
+}
+
+DETAIL_END
+
+SGUI_END
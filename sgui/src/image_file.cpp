@@ -0,0 +1,89 @@
+#include "image_file.h"
+#include "utils/mapped_file.h"
+
+#include <climits>
+#include <cstring>
+
+#include <stb_image.h>
+
+#define QOI_IMPLEMENTATION
+#include <qoi.h>
+
+SGUI_BEG
+DETAIL_BEG
+
+bool decoded_image::is_qoi(const unsigned char *data, std::size_t size)
+{
+	return size >= 4 && !std::memcmp(data, QOI_MAGIC_BYTES, 4);
+}
+
+bool decoded_image::decode(const unsigned char *data, std::size_t size, int channels)
+{
+	reset();
+
+	if (!data || !size || size > INT_MAX || channels < 0 || channels > 4)
+		return false;
+
+	if (!is_qoi(data, size))
+	{
+		// flipped by the callers that need it, stb_image's flag is global
+		stbi_set_flip_vertically_on_load_thread(false);
+		M_pixels = stbi_load_from_memory(data, static_cast<int>(size), &M_width, &M_height, &M_channels, channels);
+
+		if (M_pixels && channels)
+			M_channels = channels;
+		return M_pixels != nullptr;
+	}
+
+	// qoi only decodes into rgb or rgba, fewer channels are taken from rgba
+	qoi_desc desc;
+	M_pixels = static_cast<unsigned char *>(qoi_decode(data, static_cast<int>(size), &desc, channels && channels < 3 ? 4 : channels));
+
+	if (!M_pixels)
+		return false;
+
+	M_qoi = true;
+	M_width = static_cast<int>(desc.width);
+	M_height = static_cast<int>(desc.height);
+	M_channels = channels ? channels : desc.channels;
+
+	if (channels && channels < 3)
+	{
+		std::size_t count = static_cast<std::size_t>(M_width) * M_height;
+
+		// luminance weights of stb_image, written in place since every pixel shrinks
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			auto *src = M_pixels + 4 * i;
+			auto gray = static_cast<unsigned char>((src[0] * 77 + src[1] * 150 + src[2] * 29) >> 8);
+			auto alpha = src[3];
+
+			M_pixels[i * channels] = gray;
+			if (channels == 2)
+				M_pixels[i * 2 + 1] = alpha;
+		}
+	}
+
+	return true;
+}
+
+bool decoded_image::load(const std::string &file_name, int channels)
+{
+	mapped_file file(file_name);
+	return file.is_open() && decode(file.data(), file.size(), channels);
+}
+
+void decoded_image::reset()
+{
+	if (M_qoi)
+		qoi_free(M_pixels);
+	else
+		stbi_image_free(M_pixels);
+
+	M_pixels = nullptr;
+	M_width = M_height = M_channels = 0;
+	M_qoi = false;
+}
+
+DETAIL_END
+SGUI_END
@@ -0,0 +1,48 @@
+#ifndef IMAGE_FILE_H
+#define IMAGE_FILE_H
+#include "macro.h"
+
+#include <string>
+#include <cstddef>
+
+SGUI_BEG
+DETAIL_BEG
+
+// pixels of an image file, 8 bits per channel with rows top to bottom. Files starting with the qoi signature are decoded by qoi,
+// which is several times faster than png at similar sizes, anything else by stb_image
+class decoded_image
+{
+public:
+	decoded_image() : M_pixels{}, M_width{}, M_height{}, M_channels{}, M_qoi{} {}
+	~decoded_image() { reset(); }
+
+	decoded_image(const decoded_image &) = delete;
+	decoded_image &operator=(const decoded_image &) = delete;
+
+	// channels is 1 to 4 (converted like stb_image does), or 0 for the file's own. Returns false if data isn't an image either decoder knows
+	bool decode(const unsigned char *data, std::size_t size, int channels = 0);
+	// maps the file and decodes it
+	bool load(const std::string &file_name, int channels = 0);
+	// frees the pixels
+	void reset();
+
+	static bool is_qoi(const unsigned char *data, std::size_t size);
+
+	unsigned char *pixels() const { return M_pixels; }
+	int width() const { return M_width; }
+	int height() const { return M_height; }
+	int channels() const { return M_channels; }
+
+private:
+	unsigned char *M_pixels;
+	int M_width;
+	int M_height;
+	int M_channels;
+	// freed by qoi rather than stb_image
+	bool M_qoi;
+};
+
+DETAIL_END
+SGUI_END
+
+#endif
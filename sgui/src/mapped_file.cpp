@@ -0,0 +1,134 @@
+#include "utils/mapped_file.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+SGUI_BEG
+
+DETAIL_BEG
+
+#ifdef _WIN32
+
+bool mapped_file::open(const std::string &file_name, access_pattern access)
+{
+	close();
+
+	DWORD hint = access == access_pattern::random ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN;
+
+	HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | hint, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// mapping an empty file fails, there's nothing to map anyways
+	if (!size.QuadPart)
+	{
+		CloseHandle(file);
+		M_open = true;
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+
+	if (!mapping)
+		return false;
+
+	// the view keeps the mapping alive on its own
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+
+	if (!view)
+		return false;
+
+	M_data = static_cast<const unsigned char *>(view);
+	M_size = static_cast<std::size_t>(size.QuadPart);
+	M_open = true;
+
+	return true;
+}
+
+void mapped_file::close()
+{
+	if (M_data)
+		UnmapViewOfFile(M_data);
+
+	M_data = nullptr;
+	M_size = 0;
+	M_open = false;
+}
+
+#else
+
+bool mapped_file::open(const std::string &file_name, access_pattern access)
+{
+	close();
+
+	int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) || !S_ISREG(info.st_mode))
+	{
+		::close(fd);
+		return false;
+	}
+
+	// mapping an empty file fails, there's nothing to map anyways
+	if (!info.st_size)
+	{
+		::close(fd);
+		M_open = true;
+		return true;
+	}
+
+	auto size = static_cast<std::size_t>(info.st_size);
+
+	// the mapping keeps the file alive on its own
+	void *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (view == MAP_FAILED)
+		return false;
+
+	// a whole file about to be uploaded is read ahead, reading ahead of random reads would only waste memory
+	madvise(view, size, access == access_pattern::random ? MADV_RANDOM : MADV_WILLNEED);
+
+	M_data = static_cast<const unsigned char *>(view);
+	M_size = size;
+	M_open = true;
+
+	return true;
+}
+
+void mapped_file::close()
+{
+	if (M_data)
+		munmap(const_cast<unsigned char *>(M_data), M_size);
+
+	M_data = nullptr;
+	M_size = 0;
+	M_open = false;
+}
+
+#endif
+
+DETAIL_END
+
+SGUI_END
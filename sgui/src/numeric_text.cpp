@@ -0,0 +1,200 @@
+#include "gui/numeric_text.h"
+#include "gui/text.h"
+#include "gui/window.h"
+
+#include "utils/context_lock.h"
+
+#include "help.h"
+#include "text_detail.h"
+
+#include <algorithm>
+
+SGUI_BEG
+
+numeric_text::numeric_text(font &_font) :
+	M_chars{},
+	M_quads{},
+	M_glyphs{},
+	M_glyph_of{},
+	M_generation{},
+	M_size{},
+	M_precision{ 2 },
+	M_pens{},
+	M_bound{},
+	M_origin{},
+	M_scale{ 1, 1 },
+	M_align{ text_align::left },
+	M_font{ &_font }
+{
+	build_glyphs();
+}
+
+void numeric_text::set_font(font &_font)
+{
+	M_font = &_font;
+	build_glyphs();
+	layout(0);
+}
+
+void numeric_text::set_alignment(text_align align)
+{
+	M_align = align;
+	layout(M_size);
+}
+
+void numeric_text::build_glyphs() const
+{
+	M_generation = M_font->get_generation();
+
+	float digit_advance = 0;
+	for (char c = '0'; c <= '9'; ++c)
+		digit_advance = std::max(digit_advance, static_cast<float>(M_font->get_metrics(c).advance >> 6));
+
+	float min_y = 0;
+	float max_y = 0;
+
+	for (std::size_t i = 0; i < glyph_chars.size(); ++i)
+	{
+		char c = glyph_chars[i];
+		auto metrics = M_font->get_metrics(c);
+
+		auto &res = M_glyphs[i];
+		res.code_point = static_cast<unsigned char>(c);
+		res.offset = vec2(metrics.offset);
+		res.size = vec2(metrics.size);
+		res.advance = static_cast<float>(metrics.advance >> 6);
+
+		// tabular digits, centered in the widest digit's advance
+		if (c >= '0' && c <= '9')
+		{
+			res.offset.x += (digit_advance - res.advance) / 2;
+			res.advance = digit_advance;
+		}
+
+		M_glyph_of[static_cast<unsigned char>(c)] = static_cast<uint8_t>(i);
+
+		min_y = std::min(min_y, res.offset.y - res.size.y);
+		max_y = std::max(max_y, res.offset.y);
+	}
+
+	// vertical bounds cover every glyph a value can use, so they don't change with the value
+	M_bound.min.y = min_y;
+	M_bound.dims.y = max_y - min_y;
+}
+
+void numeric_text::assign(const char *begin, const char *end)
+{
+	auto size = static_cast<std::size_t>(end - begin);
+
+	// the common case of a value that didn't change (or only in its last digits) touches few or no quads
+	auto diff = std::mismatch(begin, end, M_chars.begin(), M_chars.begin() + M_size);
+	auto first = static_cast<std::size_t>(diff.first - begin);
+
+	if (first == size && size == M_size)
+		return;
+
+	std::copy(begin + first, end, M_chars.begin() + first);
+	M_size = size;
+
+	layout(first);
+}
+
+void numeric_text::layout(std::size_t first) const
+{
+	for (std::size_t i = first; i < M_size; ++i)
+	{
+		auto index = M_glyph_of[static_cast<unsigned char>(M_chars[i]) & 0x7F];
+		auto &cur = M_glyphs[index];
+
+		vec2 min = { M_pens[i] + cur.offset.x, cur.offset.y - cur.size.y };
+		M_quads[i] = { .min = min, .max = min + cur.size, .glyph = index };
+
+		M_pens[i + 1] = M_pens[i] + cur.advance;
+	}
+
+	float width = M_pens[M_size];
+
+	if (M_align == text_align::left)
+		M_bound.min.x = 0;
+	else if (M_align == text_align::center)
+		M_bound.min.x = -width / 2;
+	else
+		M_bound.min.x = -width;
+
+	M_bound.dims.x = width;
+}
+
+void numeric_text::update_glyphs() const
+{
+	if (M_font->get_generation() == M_generation)
+		return;
+
+	build_glyphs();
+	layout(0);
+}
+
+bound numeric_text::get_local_rect() const
+{
+	update_glyphs();
+
+	bound res = M_bound;
+
+	res.dims *= M_scale;
+	res.min *= M_scale;
+
+	return res;
+}
+
+void numeric_text::draw_raw(const window *win, vec2 absolute_min) const
+{
+	if (!M_font || !M_size)
+		return;
+
+	update_glyphs();
+
+	detail::blend_lock lock;
+	detail::cull_face_lock clock;
+	detail::shader_lock slock;
+	detail::vao_lock vlock;
+	detail::fbo_lock flock;
+
+	static auto &program = text_detail::get_shader();
+	program.set_uniform("SGUI_Ortho", win->ortho());
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	static text_detail::glyph_batch batch;
+	batch.clear();
+
+	vec2 baseline = M_origin + absolute_min;
+	baseline.x += M_bound.min.x * M_scale.x;
+
+	for (std::size_t i = 0; i < M_size; ++i)
+	{
+		auto &quad = M_quads[i];
+
+		// the table keeps metrics, the atlas slot is looked up since glyphs can be evicted
+		auto *cur = M_font->rendered_at(M_glyphs[quad.glyph].code_point);
+		if (!cur->slot.page)
+			continue;
+
+		batch.add(cur->slot, baseline + quad.min * M_scale, baseline + quad.max * M_scale, cur->size, M_col);
+	}
+
+	batch.draw(program, identity());
+}
+
+void numeric_text::obj_init()
+{
+	if (!M_parent)
+		return;
+
+	if (M_flags & attach_flags::centered)
+	{
+		auto bound = get_local_rect();
+		M_origin = (M_parent->size() - bound.dims) / 2.f - bound.min;
+	}
+}
+
+SGUI_END
@@ -0,0 +1,695 @@
+#include "graphics/pixels.h"
+
+#include "simd.h"
+
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+
+SGUI_BEG
+
+DETAIL_BEG
+
+// swaps the bytes of two rows that don't overlap
+static void swap_row(unsigned char *a, unsigned char *b, std::size_t size)
+{
+	std::size_t i = 0;
+
+#if defined(SGUI_PIXELS_SSE2)
+	for (; size - i >= 32; i += 32)
+	{
+		__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + 16));
+		__m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		__m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + 16));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(a + i), b0);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(a + i + 16), b1);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(b + i), a0);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(b + i + 16), a1);
+	}
+#elif defined(SGUI_PIXELS_NEON)
+	for (; size - i >= 32; i += 32)
+	{
+		uint8x16_t a0 = vld1q_u8(a + i);
+		uint8x16_t a1 = vld1q_u8(a + i + 16);
+		uint8x16_t b0 = vld1q_u8(b + i);
+		uint8x16_t b1 = vld1q_u8(b + i + 16);
+
+		vst1q_u8(a + i, b0);
+		vst1q_u8(a + i + 16, b1);
+		vst1q_u8(b + i, a0);
+		vst1q_u8(b + i + 16, a1);
+	}
+#endif
+
+	for (; i < size; ++i)
+		std::swap(a[i], b[i]);
+}
+
+void flip_rows(void *data, std::size_t row_bytes, std::size_t rows)
+{
+	auto *bytes = static_cast<unsigned char *>(data);
+
+	for (std::size_t y = 0; y < rows / 2; ++y)
+		swap_row(bytes + y * row_bytes, bytes + (rows - y - 1) * row_bytes, row_bytes);
+}
+
+void copy_rows_flipped(void *dst, const void *src, std::size_t row_bytes, std::size_t rows)
+{
+	auto *out = static_cast<unsigned char *>(dst);
+	auto *in = static_cast<const unsigned char *>(src);
+
+	for (std::size_t y = 0; y < rows; ++y)
+		std::memcpy(out + y * row_bytes, in + (rows - y - 1) * row_bytes, row_bytes);
+}
+
+// round(x / 255) for x in [0, 255 * 255], the same way in every kernel
+static inline uint32_t div255(uint32_t x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+static inline unsigned char unpremultiply(unsigned char c, unsigned char a)
+{
+	return a ? static_cast<unsigned char>(std::min<uint32_t>((c * 255u + a / 2u) / a, 255)) : 0;
+}
+
+// scalar kernels, which the simd ones finish the last pixels with
+
+static void gray_to_rgba_scalar(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i, dst += 4)
+	{
+		dst[0] = dst[1] = dst[2] = src[i];
+		dst[3] = 255;
+	}
+}
+
+static void gray_alpha_to_rgba_scalar(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i, dst += 4, src += 2)
+	{
+		dst[0] = dst[1] = dst[2] = src[0];
+		dst[3] = src[1];
+	}
+}
+
+static void rgb_to_rgba_scalar(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i, dst += 4, src += 3)
+	{
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = 255;
+	}
+}
+
+static void swap_red_blue_scalar(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i, dst += 4, src += 4)
+	{
+		unsigned char r = src[2];
+		unsigned char b = src[0];
+
+		dst[0] = r;
+		dst[1] = src[1];
+		dst[2] = b;
+		dst[3] = src[3];
+	}
+}
+
+static void premultiply_alpha_scalar(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i, dst += 4, src += 4)
+	{
+		unsigned char a = src[3];
+
+		dst[0] = static_cast<unsigned char>(div255(src[0] * a));
+		dst[1] = static_cast<unsigned char>(div255(src[1] * a));
+		dst[2] = static_cast<unsigned char>(div255(src[2] * a));
+		dst[3] = a;
+	}
+}
+
+static void unpremultiply_alpha_scalar(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i, dst += 4, src += 4)
+	{
+		unsigned char a = src[3];
+
+		dst[0] = unpremultiply(src[0], a);
+		dst[1] = unpremultiply(src[1], a);
+		dst[2] = unpremultiply(src[2], a);
+		dst[3] = a;
+	}
+}
+
+// every simd kernel converts as many pixels as it can, and returns how many
+
+#if defined(SGUI_PIXELS_SSE2)
+
+static std::size_t gray_to_rgba_sse2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xFF));
+
+	std::size_t i = 0;
+	for (; count - i >= 16; i += 16, dst += 64)
+	{
+		__m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+
+		__m128i gg_lo = _mm_unpacklo_epi8(gray, gray);
+		__m128i gg_hi = _mm_unpackhi_epi8(gray, gray);
+		__m128i ga_lo = _mm_unpacklo_epi8(gray, alpha);
+		__m128i ga_hi = _mm_unpackhi_epi8(gray, alpha);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_unpacklo_epi16(gg_lo, ga_lo));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), _mm_unpackhi_epi16(gg_lo, ga_lo));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 32), _mm_unpacklo_epi16(gg_hi, ga_hi));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 48), _mm_unpackhi_epi16(gg_hi, ga_hi));
+	}
+
+	return i;
+}
+
+// v holds gray alpha pairs in the low 16 bits of each 32 bit lane
+static inline __m128i expand_gray_alpha_sse2(__m128i v)
+{
+	__m128i gray = _mm_and_si128(v, _mm_set1_epi32(0xFF));
+	__m128i alpha = _mm_slli_epi32(_mm_srli_epi32(v, 8), 24);
+
+	return _mm_or_si128(_mm_or_si128(gray, _mm_slli_epi32(gray, 8)), _mm_or_si128(_mm_slli_epi32(gray, 16), alpha));
+}
+
+static std::size_t gray_alpha_to_rgba_sse2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	std::size_t i = 0;
+	for (; count - i >= 8; i += 8, dst += 32)
+	{
+		__m128i pairs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), expand_gray_alpha_sse2(_mm_unpacklo_epi16(pairs, zero)));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), expand_gray_alpha_sse2(_mm_unpackhi_epi16(pairs, zero)));
+	}
+
+	return i;
+}
+
+// v holds 4 rgb pixels in its first 12 bytes. Without ssse3's byte shuffle, pixel k is moved to lane k by shifting v left by k bytes
+static inline __m128i expand_rgb_sse2(__m128i v)
+{
+	const __m128i lane0 = _mm_setr_epi32(0xFFFFFF, 0, 0, 0);
+	const __m128i lane1 = _mm_setr_epi32(0, 0xFFFFFF, 0, 0);
+	const __m128i lane2 = _mm_setr_epi32(0, 0, 0xFFFFFF, 0);
+	const __m128i lane3 = _mm_setr_epi32(0, 0, 0, 0xFFFFFF);
+	const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+	__m128i p01 = _mm_or_si128(_mm_and_si128(v, lane0), _mm_and_si128(_mm_slli_si128(v, 1), lane1));
+	__m128i p23 = _mm_or_si128(_mm_and_si128(_mm_slli_si128(v, 2), lane2), _mm_and_si128(_mm_slli_si128(v, 3), lane3));
+
+	return _mm_or_si128(_mm_or_si128(p01, p23), alpha);
+}
+
+static std::size_t rgb_to_rgba_sse2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; count - i >= 16; i += 16, dst += 64)
+	{
+		auto *in = src + 3 * i;
+
+		// the last 4 pixels are the end of a load, so the 48 bytes read are the 16 pixels'
+		__m128i last = _mm_srli_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 32)), 4);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst), expand_rgb_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in))));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), expand_rgb_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 12))));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 32), expand_rgb_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 24))));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 48), expand_rgb_sse2(last));
+	}
+
+	return i;
+}
+
+static std::size_t swap_red_blue_sse2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	const __m128i green_alpha = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+	const __m128i low = _mm_set1_epi32(0xFF);
+
+	std::size_t i = 0;
+	for (; count - i >= 4; i += 4)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4 * i));
+
+		__m128i red_blue = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 16), low), _mm_slli_epi32(_mm_and_si128(v, low), 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4 * i), _mm_or_si128(_mm_and_si128(v, green_alpha), red_blue));
+	}
+
+	return i;
+}
+
+// 2 rgba pixels widened to 16 bits
+static inline __m128i premultiply_sse2(__m128i v)
+{
+	// alpha of each pixel in every lane, with 255 in the alpha lane so alpha stays as is
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	alpha = _mm_or_si128(_mm_and_si128(alpha, _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1)), _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+
+	__m128i x = _mm_add_epi16(_mm_mullo_epi16(v, alpha), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static std::size_t premultiply_alpha_sse2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	std::size_t i = 0;
+	for (; count - i >= 4; i += 4)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4 * i));
+
+		__m128i lo = premultiply_sse2(_mm_unpacklo_epi8(v, zero));
+		__m128i hi = premultiply_sse2(_mm_unpackhi_epi8(v, zero));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4 * i), _mm_packus_epi16(lo, hi));
+	}
+
+	return i;
+}
+
+// 1 rgba pixel widened to 32 bits. The quotient is exact: it's at least 1 / 255 away from the next integer, far more than float's rounding error
+static inline __m128i unpremultiply_sse2(__m128i v)
+{
+	__m128i alpha = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+
+	__m128i n = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(v, 8), v), _mm_srli_epi32(alpha, 1));
+	__m128i q = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(n), _mm_cvtepi32_ps(alpha)));
+
+	// transparent pixels divide by 0, and the alpha lane keeps alpha
+	__m128i opaque = _mm_andnot_si128(_mm_cmpeq_epi32(alpha, _mm_setzero_si128()), _mm_set_epi32(0, -1, -1, -1));
+	return _mm_or_si128(_mm_and_si128(q, opaque), _mm_and_si128(v, _mm_set_epi32(-1, 0, 0, 0)));
+}
+
+static std::size_t unpremultiply_alpha_sse2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	std::size_t i = 0;
+	for (; count - i >= 4; i += 4)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4 * i));
+
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+
+		// quotients above 255 saturate in the packs
+		__m128i p01 = _mm_packs_epi32(unpremultiply_sse2(_mm_unpacklo_epi16(lo, zero)), unpremultiply_sse2(_mm_unpackhi_epi16(lo, zero)));
+		__m128i p23 = _mm_packs_epi32(unpremultiply_sse2(_mm_unpacklo_epi16(hi, zero)), unpremultiply_sse2(_mm_unpackhi_epi16(hi, zero)));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4 * i), _mm_packus_epi16(p01, p23));
+	}
+
+	return i;
+}
+
+#endif
+
+#if defined(SGUI_PIXELS_AVX2)
+
+static bool has_avx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	__cpuid(info, 1);
+	// the os has to save the ymm registers
+	if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return info[1] & (1 << 5);
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+SGUI_AVX2_TARGET static std::size_t gray_to_rgba_avx2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	const __m256i alpha = _mm256_set1_epi8(static_cast<char>(0xFF));
+
+	std::size_t i = 0;
+	for (; count - i >= 32; i += 32, dst += 128)
+	{
+		// unpacks work within 128 bit lanes, so the quarters are reordered for their results to come out in order
+		__m256i gray = _mm256_permute4x64_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)), _MM_SHUFFLE(3, 1, 2, 0));
+
+		__m256i gg_lo = _mm256_unpacklo_epi8(gray, gray);
+		__m256i gg_hi = _mm256_unpackhi_epi8(gray, gray);
+		__m256i ga_lo = _mm256_unpacklo_epi8(gray, alpha);
+		__m256i ga_hi = _mm256_unpackhi_epi8(gray, alpha);
+
+		__m256i p0 = _mm256_unpacklo_epi16(gg_lo, ga_lo);
+		__m256i p1 = _mm256_unpackhi_epi16(gg_lo, ga_lo);
+		__m256i p2 = _mm256_unpacklo_epi16(gg_hi, ga_hi);
+		__m256i p3 = _mm256_unpackhi_epi16(gg_hi, ga_hi);
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_permute2x128_si256(p0, p1, 0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 32), _mm256_permute2x128_si256(p0, p1, 0x31));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 64), _mm256_permute2x128_si256(p2, p3, 0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 96), _mm256_permute2x128_si256(p2, p3, 0x31));
+	}
+
+	return i;
+}
+
+SGUI_AVX2_TARGET static std::size_t gray_alpha_to_rgba_avx2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	const __m256i gray_shuffle = _mm256_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7, 0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+
+	std::size_t i = 0;
+	for (; count - i >= 8; i += 8, dst += 32)
+	{
+		__m128i pairs = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+		__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(pairs), _mm_srli_si128(pairs, 8), 1);
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_shuffle_epi8(v, gray_shuffle));
+	}
+
+	return i;
+}
+
+SGUI_AVX2_TARGET static std::size_t rgb_to_rgba_avx2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+
+	std::size_t i = 0;
+	// the second lane reads 16 bytes for the 12 it uses, so 10 pixels have to be left
+	for (; count - i >= 10; i += 8, dst += 32)
+	{
+		auto *in = src + 3 * i;
+
+		__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in))), _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 12)), 1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha));
+	}
+
+	return i;
+}
+
+SGUI_AVX2_TARGET static std::size_t swap_red_blue_avx2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	std::size_t i = 0;
+	for (; count - i >= 8; i += 8)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 4 * i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 4 * i), _mm256_shuffle_epi8(v, shuffle));
+	}
+
+	return i;
+}
+
+SGUI_AVX2_TARGET static inline __m256i premultiply_avx2(__m256i v)
+{
+	const __m256i alpha_shuffle = _mm256_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1, 6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+
+	__m256i alpha = _mm256_or_si256(_mm256_shuffle_epi8(v, alpha_shuffle), _mm256_set1_epi64x(0x00FF000000000000));
+
+	__m256i x = _mm256_add_epi16(_mm256_mullo_epi16(v, alpha), _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+SGUI_AVX2_TARGET static std::size_t premultiply_alpha_avx2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+
+	std::size_t i = 0;
+	for (; count - i >= 8; i += 8)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 4 * i));
+
+		// unpacking and packing within lanes keeps the pixels in order
+		__m256i lo = premultiply_avx2(_mm256_unpacklo_epi8(v, zero));
+		__m256i hi = premultiply_avx2(_mm256_unpackhi_epi8(v, zero));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 4 * i), _mm256_packus_epi16(lo, hi));
+	}
+
+	return i;
+}
+
+// 2 rgba pixels widened to 32 bits, see unpremultiply_sse2
+SGUI_AVX2_TARGET static inline __m256i unpremultiply_avx2(__m256i v)
+{
+	__m256i alpha = _mm256_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+
+	__m256i n = _mm256_add_epi32(_mm256_sub_epi32(_mm256_slli_epi32(v, 8), v), _mm256_srli_epi32(alpha, 1));
+	__m256i q = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(n), _mm256_cvtepi32_ps(alpha)));
+
+	__m256i opaque = _mm256_andnot_si256(_mm256_cmpeq_epi32(alpha, _mm256_setzero_si256()), _mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+	return _mm256_or_si256(_mm256_and_si256(q, opaque), _mm256_and_si256(v, _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1)));
+}
+
+SGUI_AVX2_TARGET static std::size_t unpremultiply_alpha_avx2(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	// packs interleave the lanes, this puts the pixels back in order
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	std::size_t i = 0;
+	for (; count - i >= 8; i += 8)
+	{
+		auto *in = src + 4 * i;
+
+		__m256i p01 = unpremultiply_avx2(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in))));
+		__m256i p23 = unpremultiply_avx2(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + 8))));
+		__m256i p45 = unpremultiply_avx2(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + 16))));
+		__m256i p67 = unpremultiply_avx2(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + 24))));
+
+		__m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(p01, p23), _mm256_packs_epi32(p45, p67));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 4 * i), _mm256_permutevar8x32_epi32(packed, order));
+	}
+
+	return i;
+}
+
+#endif
+
+#if defined(SGUI_PIXELS_NEON)
+
+static std::size_t gray_to_rgba_neon(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; count - i >= 16; i += 16, dst += 64)
+	{
+		uint8x16_t gray = vld1q_u8(src + i);
+		uint8x16x4_t res = { { gray, gray, gray, vdupq_n_u8(255) } };
+		vst4q_u8(dst, res);
+	}
+
+	return i;
+}
+
+static std::size_t gray_alpha_to_rgba_neon(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; count - i >= 16; i += 16, dst += 64)
+	{
+		uint8x16x2_t pairs = vld2q_u8(src + 2 * i);
+		uint8x16x4_t res = { { pairs.val[0], pairs.val[0], pairs.val[0], pairs.val[1] } };
+		vst4q_u8(dst, res);
+	}
+
+	return i;
+}
+
+static std::size_t rgb_to_rgba_neon(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; count - i >= 16; i += 16, dst += 64)
+	{
+		uint8x16x3_t rgb = vld3q_u8(src + 3 * i);
+		uint8x16x4_t res = { { rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(255) } };
+		vst4q_u8(dst, res);
+	}
+
+	return i;
+}
+
+static std::size_t swap_red_blue_neon(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; count - i >= 16; i += 16)
+	{
+		uint8x16x4_t v = vld4q_u8(src + 4 * i);
+		std::swap(v.val[0], v.val[2]);
+		vst4q_u8(dst + 4 * i, v);
+	}
+
+	return i;
+}
+
+// round(c * a / 255), like div255
+static inline uint8x16_t premultiply_neon(uint8x16_t c, uint8x16_t a)
+{
+	uint16x8_t lo = vmull_u8(vget_low_u8(c), vget_low_u8(a));
+	uint16x8_t hi = vmull_high_u8(c, a);
+
+	// (x + 128 + ((x + 128) >> 8)) >> 8
+	lo = vaddq_u16(lo, vdupq_n_u16(128));
+	hi = vaddq_u16(hi, vdupq_n_u16(128));
+	return vcombine_u8(vshrn_n_u16(vsraq_n_u16(lo, lo, 8), 8), vshrn_n_u16(vsraq_n_u16(hi, hi, 8), 8));
+}
+
+static std::size_t premultiply_alpha_neon(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; count - i >= 16; i += 16)
+	{
+		uint8x16x4_t v = vld4q_u8(src + 4 * i);
+
+		v.val[0] = premultiply_neon(v.val[0], v.val[3]);
+		v.val[1] = premultiply_neon(v.val[1], v.val[3]);
+		v.val[2] = premultiply_neon(v.val[2], v.val[3]);
+
+		vst4q_u8(dst + 4 * i, v);
+	}
+
+	return i;
+}
+
+// 4 channel values over their alphas, see unpremultiply_sse2
+static inline uint32x4_t unpremultiply_neon(uint32x4_t c, uint32x4_t a)
+{
+	uint32x4_t n = vmlaq_n_u32(vshrq_n_u32(a, 1), c, 255);
+	uint32x4_t q = vminq_u32(vcvtq_u32_f32(vdivq_f32(vcvtq_f32_u32(n), vcvtq_f32_u32(a))), vdupq_n_u32(255));
+
+	// transparent pixels divide by 0
+	return vandq_u32(q, vtstq_u32(a, a));
+}
+
+static inline uint8x16_t unpremultiply_neon(uint8x16_t c, uint8x16_t a)
+{
+	uint16x8_t c16[2] = { vmovl_u8(vget_low_u8(c)), vmovl_high_u8(c) };
+	uint16x8_t a16[2] = { vmovl_u8(vget_low_u8(a)), vmovl_high_u8(a) };
+	uint16x4_t res[4];
+
+	for (int h = 0; h < 2; ++h)
+	{
+		res[2 * h] = vmovn_u32(unpremultiply_neon(vmovl_u16(vget_low_u16(c16[h])), vmovl_u16(vget_low_u16(a16[h]))));
+		res[2 * h + 1] = vmovn_u32(unpremultiply_neon(vmovl_high_u16(c16[h]), vmovl_high_u16(a16[h])));
+	}
+
+	return vcombine_u8(vmovn_u16(vcombine_u16(res[0], res[1])), vmovn_u16(vcombine_u16(res[2], res[3])));
+}
+
+static std::size_t unpremultiply_alpha_neon(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; count - i >= 16; i += 16)
+	{
+		uint8x16x4_t v = vld4q_u8(src + 4 * i);
+
+		v.val[0] = unpremultiply_neon(v.val[0], v.val[3]);
+		v.val[1] = unpremultiply_neon(v.val[1], v.val[3]);
+		v.val[2] = unpremultiply_neon(v.val[2], v.val[3]);
+
+		vst4q_u8(dst + 4 * i, v);
+	}
+
+	return i;
+}
+
+#endif
+
+static simd_level best_simd_level()
+{
+#if defined(SGUI_PIXELS_AVX2)
+	if (has_avx2())
+		return simd_level::avx2;
+#endif
+#if defined(SGUI_PIXELS_SSE2)
+	return simd_level::sse2;
+#elif defined(SGUI_PIXELS_NEON)
+	return simd_level::neon;
+#else
+	return simd_level::scalar;
+#endif
+}
+
+static std::atomic<simd_level> &current_simd_level()
+{
+	static std::atomic<simd_level> res{ best_simd_level() };
+	return res;
+}
+
+simd_level get_simd_level()
+{
+	return current_simd_level().load(std::memory_order_relaxed);
+}
+
+void set_simd_level(simd_level level)
+{
+	simd_level best = best_simd_level();
+
+	// neon and the x86 levels are exclusive, and avx2 implies sse2
+	bool supported = level == simd_level::scalar || level == best || (level == simd_level::sse2 && best == simd_level::avx2);
+	current_simd_level().store(supported ? level : best, std::memory_order_relaxed);
+}
+
+// runs the simd kernel of the current level that exists, and the scalar one on the pixels it left
+#if defined(SGUI_PIXELS_AVX2)
+#define SGUI_PIXEL_AVX2_CASE(kernel) case simd_level::avx2: done = kernel##_avx2(dst, src, count); break;
+#else
+#define SGUI_PIXEL_AVX2_CASE(kernel)
+#endif
+
+#if defined(SGUI_PIXELS_SSE2)
+#define SGUI_PIXEL_SSE2_CASE(kernel) case simd_level::sse2: done = kernel##_sse2(dst, src, count); break;
+#else
+#define SGUI_PIXEL_SSE2_CASE(kernel)
+#endif
+
+#if defined(SGUI_PIXELS_NEON)
+#define SGUI_PIXEL_NEON_CASE(kernel) case simd_level::neon: done = kernel##_neon(dst, src, count); break;
+#else
+#define SGUI_PIXEL_NEON_CASE(kernel)
+#endif
+
+#define SGUI_PIXEL_KERNEL(kernel, in_bytes, out_bytes) \
+	void kernel(unsigned char *dst, const unsigned char *src, std::size_t count) \
+	{ \
+		std::size_t done = 0; \
+		switch (get_simd_level()) \
+		{ \
+		SGUI_PIXEL_AVX2_CASE(kernel) \
+		SGUI_PIXEL_SSE2_CASE(kernel) \
+		SGUI_PIXEL_NEON_CASE(kernel) \
+		default: \
+			break; \
+		} \
+		kernel##_scalar(dst + (out_bytes) * done, src + (in_bytes) * done, count - done); \
+	}
+
+SGUI_PIXEL_KERNEL(gray_to_rgba, 1, 4)
+SGUI_PIXEL_KERNEL(gray_alpha_to_rgba, 2, 4)
+SGUI_PIXEL_KERNEL(rgb_to_rgba, 3, 4)
+SGUI_PIXEL_KERNEL(swap_red_blue, 4, 4)
+SGUI_PIXEL_KERNEL(premultiply_alpha, 4, 4)
+SGUI_PIXEL_KERNEL(unpremultiply_alpha, 4, 4)
+
+#undef SGUI_PIXEL_KERNEL
+#undef SGUI_PIXEL_AVX2_CASE
+#undef SGUI_PIXEL_SSE2_CASE
+#undef SGUI_PIXEL_NEON_CASE
+
+DETAIL_END
+
+SGUI_END
@@ -0,0 +1,689 @@
+#include "graphics/resample.h"
+#include "graphics/pixels.h"
+#include "utils/thread_pool.h"
+#include "utils/error.h"
+
+#include "simd.h"
+
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+SGUI_BEG
+
+// weights are fixed point, the weights of a pixel summing to 1 << weight_bits
+static constexpr int weight_bits = 14;
+static constexpr int32_t weight_round = 1 << (weight_bits - 1);
+
+// rows are spread over the pool in ranges of at least this much work (pixels times taps), smaller ones aren't worth a task
+static constexpr std::size_t min_task_work = 1 << 16;
+
+static inline unsigned char clamp_weighted(int32_t sum)
+{
+	return static_cast<unsigned char>(std::clamp((sum + weight_round) >> weight_bits, 0, 255));
+}
+
+// the source pixels each pixel of the result is made of along one axis, and their weights
+struct filter_taps
+{
+	std::vector<int> first;
+	std::vector<int> count;
+	// stride weights per pixel of the result, the ones past count are 0. stride is even, so the kernels can read them in pairs
+	std::vector<int16_t> weights;
+	int stride;
+
+	const int16_t *weights_of(std::size_t i) const { return weights.data() + i * stride; }
+};
+
+static double lanczos3(double x)
+{
+	constexpr double pi = 3.14159265358979323846;
+
+	x = std::abs(x);
+	if (x >= 3.0)
+		return 0.0;
+	if (x < 1e-8)
+		return 1.0;
+
+	return 3.0 * std::sin(pi * x) * std::sin(pi * x / 3.0) / (pi * pi * x * x);
+}
+
+static filter_taps make_taps(int src_size, int dst_size, resample_filter filter)
+{
+	double scale = static_cast<double>(src_size) / dst_size;
+	// shrinking stretches the filter over every source pixel a pixel covers
+	double filter_scale = std::max(scale, 1.0);
+	double support = (filter == resample_filter::box ? 0.5 : 3.0) * filter_scale;
+
+	filter_taps res;
+	res.stride = static_cast<int>(std::ceil(support)) * 2 + 2;
+	res.first.resize(dst_size);
+	res.count.resize(dst_size);
+	res.weights.assign(static_cast<std::size_t>(dst_size) * res.stride, 0);
+
+	std::vector<double> weights(res.stride);
+
+	for (int i = 0; i < dst_size; ++i)
+	{
+		double center = (i + 0.5) * scale;
+
+		// pixels past the edges are left out, and the weights of the others renormalized
+		int first = std::max(static_cast<int>(std::floor(center - support)), 0);
+		int count = std::min(static_cast<int>(std::ceil(center + support)), src_size) - first;
+		count = std::clamp(count, 1, res.stride);
+
+		double total = 0.0;
+		for (int j = 0; j < count; ++j)
+		{
+			double x = first + j + 0.5 - center;
+
+			if (filter == resample_filter::box)
+				weights[j] = std::max(std::min(x + 0.5, support) - std::max(x - 0.5, -support), 0.0);
+			else
+				weights[j] = lanczos3(x / filter_scale);
+
+			total += weights[j];
+		}
+
+		int16_t *out = res.weights.data() + static_cast<std::size_t>(i) * res.stride;
+
+		if (total <= 0.0)
+		{
+			std::fill(weights.begin(), weights.begin() + count, 0.0);
+			weights[count / 2] = total = 1.0;
+		}
+
+		int sum = 0;
+		int largest = 0;
+		for (int j = 0; j < count; ++j)
+		{
+			out[j] = static_cast<int16_t>(std::lround(weights[j] / total * (1 << weight_bits)));
+			sum += out[j];
+
+			if (out[j] > out[largest])
+				largest = j;
+		}
+
+		// the rounding errors go to the largest weight, so flat areas stay flat
+		out[largest] = static_cast<int16_t>(out[largest] + (1 << weight_bits) - sum);
+
+		// weights at the ends can round to 0, those pixels aren't read at all
+		int begin = 0;
+		int end = count;
+		while (end - begin > 1 && !out[begin])
+			++begin;
+		while (end - begin > 1 && !out[end - 1])
+			--end;
+
+		std::memmove(out, out + begin, (end - begin) * sizeof(int16_t));
+		std::fill(out + (end - begin), out + count, int16_t{});
+
+		res.first[i] = first + begin;
+		res.count[i] = end - begin;
+	}
+
+	return res;
+}
+
+static inline int32_t weight_pair(const int16_t *weights)
+{
+	int32_t res;
+	std::memcpy(&res, weights, sizeof(res));
+	return res;
+}
+
+// scalar kernels, which the simd ones finish the last pixels with
+
+// sums the same bytes of rows rows, weighted
+static void vertical_taps_scalar(unsigned char *dst, const unsigned char *const *rows, const int16_t *weights, int taps, std::size_t begin, std::size_t bytes)
+{
+	for (std::size_t i = begin; i < bytes; ++i)
+	{
+		int32_t sum = 0;
+		for (int t = 0; t < taps; ++t)
+			sum += weights[t] * rows[t][i];
+
+		dst[i] = clamp_weighted(sum);
+	}
+}
+
+template <int channels>
+static void horizontal_taps_scalar(unsigned char *dst, const unsigned char *src, const filter_taps &taps, int begin, int count)
+{
+	for (int x = begin; x < count; ++x)
+	{
+		auto *in = src + static_cast<std::size_t>(taps.first[x]) * channels;
+		auto *weights = taps.weights_of(x);
+
+		int32_t sum[channels] = {};
+		for (int t = 0; t < taps.count[x]; ++t, in += channels)
+			for (int c = 0; c < channels; ++c)
+				sum[c] += weights[t] * in[c];
+
+		for (int c = 0; c < channels; ++c)
+			dst[static_cast<std::size_t>(x) * channels + c] = clamp_weighted(sum[c]);
+	}
+}
+
+// pixels begin to count of a row of the next mip level, out of two rows of width pixels, each pixel averaging the 2x2 pixels it covers.
+// Odd sizes leave the last column out, like OpenGL's, 1 pixel wide rows repeat their pixel
+static void halve_row_scalar(unsigned char *dst, const unsigned char *row0, const unsigned char *row1, int width, int channels, std::size_t begin, std::size_t count)
+{
+	for (std::size_t x = begin; x < count; ++x)
+	{
+		std::size_t x0 = std::min<std::size_t>(2 * x, width - 1) * channels;
+		std::size_t x1 = std::min<std::size_t>(2 * x + 1, width - 1) * channels;
+
+		for (int c = 0; c < channels; ++c)
+			dst[x * channels + c] = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+	}
+}
+
+#if defined(SGUI_PIXELS_SSE2)
+
+static std::size_t vertical_taps_sse2(unsigned char *dst, const unsigned char *const *rows, const int16_t *weights, int taps, std::size_t bytes)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(weight_round);
+
+	std::size_t i = 0;
+	for (; bytes - i >= 16; i += 16)
+	{
+		__m128i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+
+		// two rows at a time, their bytes interleaved for madd to weigh and add them. The second row of an odd last pair weighs 0
+		for (int t = 0; t < taps; t += 2)
+		{
+			__m128i w = _mm_set1_epi32(weight_pair(weights + t));
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[t] + i));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[std::min(t + 1, taps - 1)] + i));
+
+			__m128i a_lo = _mm_unpacklo_epi8(a, zero), a_hi = _mm_unpackhi_epi8(a, zero);
+			__m128i b_lo = _mm_unpacklo_epi8(b, zero), b_hi = _mm_unpackhi_epi8(b, zero);
+
+			acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a_lo, b_lo), w));
+			acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a_lo, b_lo), w));
+			acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(a_hi, b_hi), w));
+			acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(a_hi, b_hi), w));
+		}
+
+		acc0 = _mm_srai_epi32(_mm_add_epi32(acc0, round), weight_bits);
+		acc1 = _mm_srai_epi32(_mm_add_epi32(acc1, round), weight_bits);
+		acc2 = _mm_srai_epi32(_mm_add_epi32(acc2, round), weight_bits);
+		acc3 = _mm_srai_epi32(_mm_add_epi32(acc3, round), weight_bits);
+
+		// the saturating packs clamp to [0, 255] like the scalar kernel
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(_mm_packs_epi32(acc0, acc1), _mm_packs_epi32(acc2, acc3)));
+	}
+
+	return i;
+}
+
+static std::size_t horizontal_taps_rgba_sse2(unsigned char *dst, const unsigned char *src, const filter_taps &taps, int count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(weight_round);
+
+	for (int x = 0; x < count; ++x)
+	{
+		auto *in = src + static_cast<std::size_t>(taps.first[x]) * 4;
+		auto *weights = taps.weights_of(x);
+		int n = taps.count[x];
+
+		__m128i acc = zero;
+
+		// two pixels at a time, their channels interleaved for madd to weigh and add them
+		int t = 0;
+		for (; n - t >= 2; t += 2)
+		{
+			__m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + 4 * t)), zero);
+			v = _mm_unpacklo_epi16(v, _mm_srli_si128(v, 8));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(v, _mm_set1_epi32(weight_pair(weights + t))));
+		}
+
+		if (t < n)
+		{
+			int32_t last;
+			std::memcpy(&last, in + 4 * t, sizeof(last));
+
+			__m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(last), zero), zero);
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(v, _mm_set1_epi32(static_cast<uint16_t>(weights[t]))));
+		}
+
+		__m128i res = _mm_srai_epi32(_mm_add_epi32(acc, round), weight_bits);
+		res = _mm_packs_epi32(res, res);
+
+		int32_t pixel = _mm_cvtsi128_si32(_mm_packus_epi16(res, res));
+		std::memcpy(dst + 4 * static_cast<std::size_t>(x), &pixel, sizeof(pixel));
+	}
+
+	return static_cast<std::size_t>(count);
+}
+
+// sums of 2 neighbouring pixels of 8 16 bit lanes each, for 1, 2 and 4 channels
+static inline __m128i pair_sums_sse2(__m128i lo, __m128i hi, int channels)
+{
+	switch (channels)
+	{
+	case 1:
+		return _mm_packs_epi32(_mm_madd_epi16(lo, _mm_set1_epi16(1)), _mm_madd_epi16(hi, _mm_set1_epi16(1)));
+	case 2:
+		// pixels are 32 bits, the even ones are moved to the low halves
+		lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+		hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+		return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+	default:
+		return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+	}
+}
+
+static std::size_t halve_row_sse2(unsigned char *dst, const unsigned char *row0, const unsigned char *row1, int channels, std::size_t bytes)
+{
+	if (channels == 3)
+		return 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+
+	std::size_t i = 0;
+	for (; bytes - i >= 8; i += 8)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 2 * i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 2 * i));
+
+		__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+		__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+		__m128i res = _mm_srli_epi16(_mm_add_epi16(pair_sums_sse2(lo, hi, channels), two), 2);
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(res, res));
+	}
+
+	return i;
+}
+
+#endif
+
+#if defined(SGUI_PIXELS_AVX2)
+
+// the sse2 kernel 32 bytes at a time. Unpacks and packs both work within 128 bit lanes, so the bytes come out in order
+SGUI_AVX2_TARGET static std::size_t vertical_taps_avx2(unsigned char *dst, const unsigned char *const *rows, const int16_t *weights, int taps, std::size_t bytes)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i round = _mm256_set1_epi32(weight_round);
+
+	std::size_t i = 0;
+	for (; bytes - i >= 32; i += 32)
+	{
+		__m256i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+
+		for (int t = 0; t < taps; t += 2)
+		{
+			__m256i w = _mm256_set1_epi32(weight_pair(weights + t));
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[t] + i));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[std::min(t + 1, taps - 1)] + i));
+
+			__m256i a_lo = _mm256_unpacklo_epi8(a, zero), a_hi = _mm256_unpackhi_epi8(a, zero);
+			__m256i b_lo = _mm256_unpacklo_epi8(b, zero), b_hi = _mm256_unpackhi_epi8(b, zero);
+
+			acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi16(a_lo, b_lo), w));
+			acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi16(a_lo, b_lo), w));
+			acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi16(a_hi, b_hi), w));
+			acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi16(a_hi, b_hi), w));
+		}
+
+		acc0 = _mm256_srai_epi32(_mm256_add_epi32(acc0, round), weight_bits);
+		acc1 = _mm256_srai_epi32(_mm256_add_epi32(acc1, round), weight_bits);
+		acc2 = _mm256_srai_epi32(_mm256_add_epi32(acc2, round), weight_bits);
+		acc3 = _mm256_srai_epi32(_mm256_add_epi32(acc3, round), weight_bits);
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_packus_epi16(_mm256_packs_epi32(acc0, acc1), _mm256_packs_epi32(acc2, acc3)));
+	}
+
+	return i;
+}
+
+SGUI_AVX2_TARGET static inline __m256i pair_sums_avx2(__m256i lo, __m256i hi, int channels)
+{
+	switch (channels)
+	{
+	case 1:
+		return _mm256_packs_epi32(_mm256_madd_epi16(lo, _mm256_set1_epi16(1)), _mm256_madd_epi16(hi, _mm256_set1_epi16(1)));
+	case 2:
+		lo = _mm256_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+		hi = _mm256_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+		return _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+	default:
+		return _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+	}
+}
+
+SGUI_AVX2_TARGET static std::size_t halve_row_avx2(unsigned char *dst, const unsigned char *row0, const unsigned char *row1, int channels, std::size_t bytes)
+{
+	if (channels == 3)
+		return 0;
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i two = _mm256_set1_epi16(2);
+
+	std::size_t i = 0;
+	for (; bytes - i >= 16; i += 16)
+	{
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row0 + 2 * i));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row1 + 2 * i));
+
+		__m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+		__m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+
+		__m256i res = _mm256_srli_epi16(_mm256_add_epi16(pair_sums_avx2(lo, hi, channels), two), 2);
+
+		// each lane holds 8 bytes of the result, twice
+		res = _mm256_permute4x64_epi64(_mm256_packus_epi16(res, res), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(res));
+	}
+
+	return i;
+}
+
+#endif
+
+#if defined(SGUI_PIXELS_NEON)
+
+static std::size_t vertical_taps_neon(unsigned char *dst, const unsigned char *const *rows, const int16_t *weights, int taps, std::size_t bytes)
+{
+	std::size_t i = 0;
+	for (; bytes - i >= 16; i += 16)
+	{
+		int32x4_t acc0 = vdupq_n_s32(0), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+
+		for (int t = 0; t < taps; ++t)
+		{
+			uint8x16_t v = vld1q_u8(rows[t] + i);
+			int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v)));
+			int16x8_t hi = vreinterpretq_s16_u16(vmovl_high_u8(v));
+
+			acc0 = vmlal_n_s16(acc0, vget_low_s16(lo), weights[t]);
+			acc1 = vmlal_high_n_s16(acc1, lo, weights[t]);
+			acc2 = vmlal_n_s16(acc2, vget_low_s16(hi), weights[t]);
+			acc3 = vmlal_high_n_s16(acc3, hi, weights[t]);
+		}
+
+		// rounding shifts and saturating narrows, which clamp to [0, 255] like the scalar kernel
+		int16x8_t lo = vcombine_s16(vqrshrn_n_s32(acc0, weight_bits), vqrshrn_n_s32(acc1, weight_bits));
+		int16x8_t hi = vcombine_s16(vqrshrn_n_s32(acc2, weight_bits), vqrshrn_n_s32(acc3, weight_bits));
+
+		vst1q_u8(dst + i, vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi)));
+	}
+
+	return i;
+}
+
+static std::size_t horizontal_taps_rgba_neon(unsigned char *dst, const unsigned char *src, const filter_taps &taps, int count)
+{
+	for (int x = 0; x < count; ++x)
+	{
+		auto *in = src + static_cast<std::size_t>(taps.first[x]) * 4;
+		auto *weights = taps.weights_of(x);
+
+		int32x4_t acc = vdupq_n_s32(0);
+
+		for (int t = 0; t < taps.count[x]; ++t, in += 4)
+		{
+			uint32_t pixel;
+			std::memcpy(&pixel, in, sizeof(pixel));
+
+			int16x4_t v = vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixel)))));
+			acc = vmlal_n_s16(acc, v, weights[t]);
+		}
+
+		int16x4_t res = vqrshrn_n_s32(acc, weight_bits);
+		uint32_t pixel = vget_lane_u32(vreinterpret_u32_u8(vqmovun_s16(vcombine_s16(res, res))), 0);
+		std::memcpy(dst + 4 * static_cast<std::size_t>(x), &pixel, sizeof(pixel));
+	}
+
+	return static_cast<std::size_t>(count);
+}
+
+static std::size_t halve_row_neon(unsigned char *dst, const unsigned char *row0, const unsigned char *row1, int channels, std::size_t bytes)
+{
+	if (channels == 3)
+		return 0;
+
+	std::size_t i = 0;
+	for (; bytes - i >= 8; i += 8)
+	{
+		uint8x16_t a = vld1q_u8(row0 + 2 * i);
+		uint8x16_t b = vld1q_u8(row1 + 2 * i);
+
+		uint16x8_t lo = vaddl_u8(vget_low_u8(a), vget_low_u8(b));
+		uint16x8_t hi = vaddl_high_u8(a, b);
+		uint16x8_t sum;
+
+		switch (channels)
+		{
+		case 1:
+			sum = vpaddq_u16(lo, hi);
+			break;
+		case 2:
+			sum = vaddq_u16(vreinterpretq_u16_u32(vuzp1q_u32(vreinterpretq_u32_u16(lo), vreinterpretq_u32_u16(hi))),
+				vreinterpretq_u16_u32(vuzp2q_u32(vreinterpretq_u32_u16(lo), vreinterpretq_u32_u16(hi))));
+			break;
+		default:
+			sum = vaddq_u16(vreinterpretq_u16_u64(vuzp1q_u64(vreinterpretq_u64_u16(lo), vreinterpretq_u64_u16(hi))),
+				vreinterpretq_u16_u64(vuzp2q_u64(vreinterpretq_u64_u16(lo), vreinterpretq_u64_u16(hi))));
+			break;
+		}
+
+		vst1_u8(dst + i, vmovn_u16(vrshrq_n_u16(sum, 2)));
+	}
+
+	return i;
+}
+
+#endif
+
+// runs the simd kernel of the current level that exists, and the scalar one on the pixels it left
+
+static void vertical_taps(unsigned char *dst, const unsigned char *const *rows, const int16_t *weights, int taps, std::size_t bytes)
+{
+	std::size_t done = 0;
+
+	switch (detail::get_simd_level())
+	{
+#if defined(SGUI_PIXELS_AVX2)
+	case detail::simd_level::avx2:
+		done = vertical_taps_avx2(dst, rows, weights, taps, bytes);
+		break;
+#endif
+#if defined(SGUI_PIXELS_SSE2)
+	case detail::simd_level::sse2:
+		done = vertical_taps_sse2(dst, rows, weights, taps, bytes);
+		break;
+#endif
+#if defined(SGUI_PIXELS_NEON)
+	case detail::simd_level::neon:
+		done = vertical_taps_neon(dst, rows, weights, taps, bytes);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	vertical_taps_scalar(dst, rows, weights, taps, done, bytes);
+}
+
+static void horizontal_taps(unsigned char *dst, const unsigned char *src, const filter_taps &taps, int count, int channels)
+{
+	switch (channels)
+	{
+	case 1:
+		horizontal_taps_scalar<1>(dst, src, taps, 0, count);
+		return;
+	case 2:
+		horizontal_taps_scalar<2>(dst, src, taps, 0, count);
+		return;
+	case 3:
+		horizontal_taps_scalar<3>(dst, src, taps, 0, count);
+		return;
+	default:
+		break;
+	}
+
+	std::size_t done = 0;
+
+	// only rgba has simd kernels, its pixels fill a 32 bit lane
+	switch (detail::get_simd_level())
+	{
+#if defined(SGUI_PIXELS_SSE2)
+	case detail::simd_level::avx2:
+	case detail::simd_level::sse2:
+		done = horizontal_taps_rgba_sse2(dst, src, taps, count);
+		break;
+#endif
+#if defined(SGUI_PIXELS_NEON)
+	case detail::simd_level::neon:
+		done = horizontal_taps_rgba_neon(dst, src, taps, count);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	horizontal_taps_scalar<4>(dst, src, taps, static_cast<int>(done), count);
+}
+
+static void halve_row(unsigned char *dst, const unsigned char *row0, const unsigned char *row1, int width, int channels)
+{
+	std::size_t count = static_cast<std::size_t>(std::max(width / 2, 1));
+	std::size_t bytes = count * channels;
+	std::size_t done = 0;
+
+	// the simd kernels read two pixels for each one they write, 1 pixel wide rows are left to the scalar kernel
+	if (width > 1)
+	{
+		switch (detail::get_simd_level())
+		{
+#if defined(SGUI_PIXELS_AVX2)
+		case detail::simd_level::avx2:
+			done = halve_row_avx2(dst, row0, row1, channels, bytes);
+			break;
+#endif
+#if defined(SGUI_PIXELS_SSE2)
+		case detail::simd_level::sse2:
+			done = halve_row_sse2(dst, row0, row1, channels, bytes);
+			break;
+#endif
+#if defined(SGUI_PIXELS_NEON)
+		case detail::simd_level::neon:
+			done = halve_row_neon(dst, row0, row1, channels, bytes);
+			break;
+#endif
+		default:
+			break;
+		}
+	}
+
+	halve_row_scalar(dst, row0, row1, width, channels, done / channels, count);
+}
+
+// body over ranges of rows, on the pool's threads if there's one. row_work estimates the pixels times taps of a row
+static void for_rows(thread_pool *pool, int rows, std::size_t row_work, const std::function<void(std::size_t, std::size_t)> &body)
+{
+	if (!pool)
+	{
+		body(0, static_cast<std::size_t>(rows));
+		return;
+	}
+
+	pool->parallel_for(0, static_cast<std::size_t>(rows), body, std::max<std::size_t>(min_task_work / std::max<std::size_t>(row_work, 1), 1));
+}
+
+static bool is_valid_image(int width, int height, int channels)
+{
+	if (width > 0 && height > 0 && channels >= 1 && channels <= 4)
+		return true;
+
+	detail::log_error(error("Image sizes have to be positive, with 1 to 4 channels.", error_code::invalid_argument));
+	return false;
+}
+
+bool resample_image(const unsigned char *src, int src_width, int src_height, unsigned char *dst, int dst_width, int dst_height, int channels,
+	resample_filter filter, thread_pool *pool)
+{
+	if (!is_valid_image(src_width, src_height, channels) || !is_valid_image(dst_width, dst_height, channels))
+		return false;
+
+	filter_taps columns = make_taps(src_width, dst_width, filter);
+	filter_taps rows = make_taps(src_height, dst_height, filter);
+
+	std::size_t src_row_bytes = static_cast<std::size_t>(src_width) * channels;
+	std::size_t dst_row_bytes = static_cast<std::size_t>(dst_width) * channels;
+	std::size_t row_work = src_row_bytes * rows.stride / 2 + dst_row_bytes * columns.stride / 2;
+
+	// each row of the result is filtered vertically out of the source rows it covers, at the source's width, then horizontally
+	for_rows(pool, dst_height, row_work, [&](std::size_t first, std::size_t last)
+	{
+		std::vector<unsigned char> line(src_row_bytes);
+		std::vector<const unsigned char *> sources(rows.stride);
+
+		for (std::size_t y = first; y < last; ++y)
+		{
+			int taps = rows.count[y];
+			for (int t = 0; t < taps; ++t)
+				sources[t] = src + static_cast<std::size_t>(rows.first[y] + t) * src_row_bytes;
+
+			vertical_taps(line.data(), sources.data(), rows.weights_of(y), taps, src_row_bytes);
+			horizontal_taps(dst + y * dst_row_bytes, line.data(), columns, dst_width, channels);
+		}
+	});
+
+	return true;
+}
+
+std::vector<mip_level> build_mip_chain(const unsigned char *src, int width, int height, int channels, resample_filter filter, thread_pool *pool, int max_levels)
+{
+	std::vector<mip_level> res;
+
+	if (!is_valid_image(width, height, channels))
+		return res;
+
+	const unsigned char *prev = src;
+
+	while ((width > 1 || height > 1) && (max_levels <= 0 || static_cast<int>(res.size()) < max_levels))
+	{
+		mip_level next{ std::max(width / 2, 1), std::max(height / 2, 1), {} };
+		next.pixels.resize(static_cast<std::size_t>(next.width) * next.height * channels);
+
+		if (filter == resample_filter::box)
+		{
+			std::size_t row_bytes = static_cast<std::size_t>(width) * channels;
+			std::size_t res_row_bytes = static_cast<std::size_t>(next.width) * channels;
+			unsigned char *out = next.pixels.data();
+
+			for_rows(pool, next.height, 2 * row_bytes, [&](std::size_t first, std::size_t last)
+			{
+				for (std::size_t y = first; y < last; ++y)
+				{
+					auto *row0 = prev + std::min<std::size_t>(2 * y, height - 1) * row_bytes;
+					auto *row1 = prev + std::min<std::size_t>(2 * y + 1, height - 1) * row_bytes;
+
+					halve_row(out + y * res_row_bytes, row0, row1, width, channels);
+				}
+			});
+		}
+		else
+			resample_image(prev, width, height, next.pixels.data(), next.width, next.height, channels, filter, pool);
+
+		width = next.width;
+		height = next.height;
+
+		// moving the level keeps its pixels where they are
+		res.push_back(std::move(next));
+		prev = res.back().pixels.data();
+	}
+
+	return res;
+}
+
+SGUI_END
@@ -0,0 +1,167 @@
+#include "graphics/residency.h"
+#include "graphics/texture.h"
+
+SGUI_BEG
+
+residency_manager::residency_manager() : M_sizes{}, M_stats{}, M_total{}, M_budget{}, M_evictions{}, M_frame{ 1 } {}
+
+residency_manager &residency_manager::get()
+{
+	// never destroyed, textures and buffers owned by statics are destroyed after it would be
+	static auto *res = new residency_manager();
+	return *res;
+}
+
+void residency_manager::set_budget(std::size_t bytes)
+{
+	M_budget = bytes;
+	make_room(0);
+}
+
+bool residency_manager::is_evicted(const texture &text) const
+{
+	auto it = M_evictable.find(&text);
+	return it != M_evictable.end() && it->second->evicted;
+}
+
+void residency_manager::set_evictable(texture &text, restore_callback restore)
+{
+	auto it = M_evictable.find(&text);
+
+	if (!restore)
+	{
+		if (it == M_evictable.end())
+			return;
+
+		auto entry = it->second;
+		if (entry->evicted)
+			this->restore(*entry);
+
+		M_lru.erase(entry);
+		M_evictable.erase(it);
+		return;
+	}
+
+	if (it != M_evictable.end())
+	{
+		it->second->restore = std::move(restore);
+		return;
+	}
+
+	M_lru.push_back({ .text = &text, .restore = std::move(restore), .last_used = M_frame, .evicted = false });
+	M_evictable.emplace(&text, std::prev(M_lru.end()));
+
+	make_room(0);
+}
+
+void residency_manager::make_resident(const texture &text)
+{
+	auto it = M_evictable.find(&text);
+	if (it == M_evictable.end())
+		return;
+
+	auto entry = it->second;
+	entry->last_used = M_frame;
+	M_lru.splice(M_lru.end(), M_lru, entry);
+
+	if (entry->evicted)
+		restore(*entry);
+}
+
+void residency_manager::restore(evictable &entry)
+{
+	entry.evicted = false;
+	entry.last_used = M_frame;
+
+	// the callback reallocates the texture, which can evict others to make room for it
+	entry.restore(*entry.text);
+}
+
+void residency_manager::track(resource_category category, uintptr_t key, std::size_t bytes)
+{
+	if (!key)
+		return;
+
+	auto index = static_cast<std::size_t>(category);
+	auto [it, inserted] = M_sizes[index].try_emplace(key, 0);
+
+	auto &stats = M_stats[index];
+	if (inserted)
+		++stats.resources;
+
+	stats.bytes = stats.bytes - it->second + bytes;
+	M_total = M_total - it->second + bytes;
+
+	bool grew = bytes > it->second;
+	it->second = bytes;
+
+	if (grew)
+		make_room(category == resource_category::texture ? key : 0);
+}
+
+void residency_manager::untrack(resource_category category, uintptr_t key)
+{
+	auto index = static_cast<std::size_t>(category);
+
+	auto it = M_sizes[index].find(key);
+	if (it == M_sizes[index].end())
+		return;
+
+	auto &stats = M_stats[index];
+	--stats.resources;
+	stats.bytes -= it->second;
+	M_total -= it->second;
+
+	M_sizes[index].erase(it);
+}
+
+void residency_manager::moved(const texture &from, const texture &to)
+{
+	auto &sizes = M_sizes[static_cast<std::size_t>(resource_category::texture)];
+
+	if (auto node = sizes.extract(detail::residency_key(&from)))
+	{
+		node.key() = detail::residency_key(&to);
+		sizes.insert(std::move(node));
+	}
+
+	if (auto node = M_evictable.extract(&from))
+	{
+		node.mapped()->text = const_cast<texture *>(&to);
+		node.key() = &to;
+		M_evictable.insert(std::move(node));
+	}
+}
+
+void residency_manager::forget(const texture &text)
+{
+	auto it = M_evictable.find(&text);
+	if (it == M_evictable.end())
+		return;
+
+	M_lru.erase(it->second);
+	M_evictable.erase(it);
+}
+
+void residency_manager::make_room(uintptr_t skip)
+{
+	if (!M_budget)
+		return;
+
+	for (auto it = M_lru.begin(); it != M_lru.end() && M_total > M_budget; ++it)
+	{
+		// the list is ordered by last use, so the rest is used by the current frame as well
+		if (it->last_used >= M_frame)
+			break;
+
+		if (it->evicted || detail::residency_key(it->text) == skip)
+			continue;
+
+		// releases the texture's storage, which untracks it, but keeps its size and description for the restore
+		it->text->destroy();
+		it->evicted = true;
+		++M_evictions;
+	}
+}
+
+SGUI_END
@@ -1,4 +1,5 @@
 #include "graphics/shaders.h"
+#include "graphics/residency.h"
 
 #include "utils/context_lock.h"
 
@@ -210,7 +211,12 @@ void shader::set_uniform(const std::string &name, const mat4 &val)
 
 void shader::set_uniform(const std::string &name, const texture &val)
 {
-	textures[get_loc(name)] = &val;
+	// called for every draw, so the origin's location is only looked up the first time the sampler is set
+	auto [it, inserted] = textures.try_emplace(get_loc(name), sampler{ &val, -1 });
+	if (inserted)
+		it->second.top_left_loc = get_loc(name + "_top_left");
+	else
+		it->second.text = &val;
 }
 
 void shader::bind()
@@ -225,8 +231,12 @@ void shader::bind()
 		glUniform1i(it->first, i);
 		// activate texture
 		texture::activate_unit(i);
-		// bind corresponding texture
-		it->second->use();
+		// bind corresponding texture, restoring it first if it was evicted
+		residency_manager::get().make_resident(*it->second.text);
+		it->second.text->use();
+		// send the row the texture starts with
+		if (it->second.top_left_loc != -1)
+			glUniform1i(it->second.top_left_loc, it->second.text->get_origin() == texture_origin::top_left);
 	}
 }
 
@@ -0,0 +1,25 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// instruction sets the pixel kernels are compiled for, see detail::simd_level for the one they run on
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SGUI_PIXELS_SSE2
+#include <emmintrin.h>
+// avx2 kernels are compiled for the cpus that have it, and picked at runtime
+#if defined(__GNUC__) || defined(__clang__)
+#define SGUI_PIXELS_AVX2
+#define SGUI_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+#define SGUI_PIXELS_AVX2
+#define SGUI_AVX2_TARGET
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define SGUI_PIXELS_NEON
+#include <arm_neon.h>
+#endif
+
+#endif
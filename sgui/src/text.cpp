@@ -5,14 +5,21 @@
 #include "graphics/shaders.h"
 
 #include "utils/error.h"
+#include "utils/utf.h"
 
 #include "help.h"
+#include "text_detail.h"
 
 #include <stdexcept>
 #include <algorithm>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <filesystem>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_OUTLINE_H
 
 SGUI_BEG
 
@@ -20,6 +27,8 @@ DETAIL_BEG
 struct library_handle
 {
 	FT_Library library;
+	// creating and destroying faces isn't thread safe within a library
+	std::mutex mutex;
 
 	library_handle() : library{}
 	{
@@ -43,17 +52,23 @@ font::face_handle::face_handle() : face{}, size{ default_height } {}
 
 void font::face_handle::load(detail::library_handle &lib, const std::string &file_name)
 {
+	std::lock_guard lock(lib.mutex);
 	if (FT_New_Face(lib.library, file_name.data(), 0, &face))
 		detail::log_error(error("Could not load font " + file_name + '.', error_code::freetype_font_failure));
 }
 void font::face_handle::load(detail::library_handle &lib, const void *data, std::size_t size)
 {
+	std::lock_guard lock(lib.mutex);
 	if (FT_New_Memory_Face(lib.library, reinterpret_cast<const FT_Byte *>(data), static_cast<FT_Long>(size), 0, &face))
 		detail::log_error(error("Could not load font.", error_code::freetype_font_failure));
 }
 
 font::face_handle::~face_handle()
 {
+	if (!face)
+		return;
+
+	std::lock_guard lock(get_library().mutex);
 	FT_Done_Face(face);
 }
 
@@ -64,7 +79,11 @@ font::face_handle::face_handle(face_handle &&other) noexcept : face{ other.face
 }
 font::face_handle &font::face_handle::operator=(face_handle &&other) noexcept
 {
-	FT_Done_Face(face);
+	if (face)
+	{
+		std::lock_guard lock(get_library().mutex);
+		FT_Done_Face(face);
+	}
 	face = other.face;
 	size = other.size;
 	other.face = nullptr;
@@ -78,77 +97,507 @@ void font::face_handle::resize()
 	FT_Set_Pixel_Sizes(face, 0, size);
 }
 
+struct font_registry
+{
+	std::mutex mutex;
+	// type erased, since the shared faces are private to font
+	std::unordered_map<std::string, std::weak_ptr<void>> faces;
+
+	static font_registry &get()
+	{
+		static font_registry res;
+		return res;
+	}
+
+	std::shared_ptr<void> find(const std::string &key)
+	{
+		auto it = faces.find(key);
+		if (it == faces.end())
+			return nullptr;
+		return it->second.lock();
+	}
+
+	void insert(const std::string &key, std::weak_ptr<void> face)
+	{
+		// faces are only created on a miss, so sweeping dead entries here is cheap enough
+		std::erase_if(faces, [](const auto &entry) { return entry.second.expired(); });
+		faces[key] = std::move(face);
+	}
+};
+
+uint64_t hash_bytes(const unsigned char *data, std::size_t size)
+{
+	// FNV-1a
+	uint64_t res = 0xcbf29ce484222325;
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		res ^= data[i];
+		res *= 0x100000001b3;
+	}
+	return res;
+}
+
+// hashes code points rather than bytes, so it doesn't depend on how wide the string is stored
+uint64_t hash_code_points(code_point_view str)
+{
+	// FNV-1a
+	uint64_t res = 0xcbf29ce484222325;
+	for (uint32_t c : str)
+	{
+		res ^= c;
+		res *= 0x100000001b3;
+	}
+	return res;
+}
+
+struct run_key
+{
+	// faces are interned per height, so the face also stands for the size
+	const void *face;
+	uint64_t generation;
+	float max_width;
+	float line_height;
+	text_align align;
+	uint64_t hash;
+
+	bool operator==(const run_key &) const = default;
+};
+
+struct run_key_hash
+{
+	std::size_t operator()(const run_key &key) const
+	{
+		std::size_t res = std::hash<const void *>{}(key.face);
+		for (std::size_t cur : { std::size_t(key.generation), std::hash<float>{}(key.max_width), std::hash<float>{}(key.line_height), std::size_t(key.align), std::size_t(key.hash) })
+			res ^= cur + 0x9e3779b97f4a7c15 + (res << 6) + (res >> 2);
+		return res;
+	}
+};
+
+struct run_cache
+{
+	std::mutex mutex;
+	// runs are shared while any text uses them
+	std::unordered_map<run_key, std::weak_ptr<const shaped_run>, run_key_hash> runs;
+	std::size_t sweep_at = 64;
+
+	static run_cache &get()
+	{
+		static run_cache res;
+		return res;
+	}
+
+	void insert(const run_key &key, std::weak_ptr<const shaped_run> run)
+	{
+		// sweep dead entries whenever the map doubles, so inserting stays amortized O(1)
+		if (runs.size() >= sweep_at)
+		{
+			std::erase_if(runs, [](const auto &entry) { return entry.second.expired(); });
+			sweep_at = std::max<std::size_t>(64, runs.size() * 2);
+		}
+		runs[key] = std::move(run);
+	}
+};
+
+font::font() : M_face{ std::make_shared<shared_face>(default_height) } {}
+
 void font::load(const std::string &file_name, unsigned int height)
 {
-	M_chars.clear();
+	std::error_code ec;
+	auto path = std::filesystem::weakly_canonical(file_name, ec);
+	std::string key = "file:" + (ec ? file_name : path.string()) + ':' + std::to_string(height);
 
-	face.load(get_library(), file_name);
+	auto &registry = font_registry::get();
+	std::lock_guard lock(registry.mutex);
 
-	face.size = height;
-	face.resize();
+	if (auto existing = registry.find(key))
+	{
+		M_face = std::static_pointer_cast<shared_face>(std::move(existing));
+		return;
+	}
+
+	auto res = std::make_shared<shared_face>(height);
+
+	res->face.load(get_library(), file_name);
+	res->face.size = height;
+	res->face.resize();
+
+	// don't intern failed loads, so the file can be retried
+	if (res->face.face)
+		registry.insert(key, res);
+
+	M_face = std::move(res);
 }
 
 void font::load(const void *data, std::size_t size, unsigned int height)
 {
-	M_chars.clear();
+	auto *bytes = reinterpret_cast<const unsigned char *>(data);
+	std::string key = "data:" + std::to_string(hash_bytes(bytes, size)) + ':' + std::to_string(size) + ':' + std::to_string(height);
+
+	auto &registry = font_registry::get();
+	std::lock_guard lock(registry.mutex);
+
+	auto existing = std::static_pointer_cast<shared_face>(registry.find(key));
+	if (existing && std::equal(bytes, bytes + size, existing->data.begin(), existing->data.end()))
+	{
+		M_face = std::move(existing);
+		return;
+	}
+
+	auto res = std::make_shared<shared_face>(height);
+
+	res->data.assign(bytes, bytes + size);
+	res->face.load(get_library(), res->data.data(), res->data.size());
+	res->face.size = height;
+	res->face.resize();
+
+	// on a hash collision the face simply isn't interned
+	if (res->face.face && !existing)
+		registry.insert(key, res);
+
+	M_face = std::move(res);
+}
+
+std::size_t font::run_cache_size()
+{
+	auto &cache = run_cache::get();
+	std::lock_guard lock(cache.mutex);
+
+	return std::count_if(cache.runs.begin(), cache.runs.end(), [](const auto &entry) { return !entry.second.expired(); });
+}
+
+std::shared_ptr<const shaped_run> font::shape(code_point_view str, const paragraph_layout &layout) const
+{
+	run_key key{};
+	key.face = M_face.get();
+	key.max_width = layout.get_max_width();
+	key.line_height = layout.get_line_height();
+	key.align = layout.get_alignment();
+	key.hash = hash_code_points(str);
+
+	{
+		std::lock_guard lock(M_face->mutex);
+		key.generation = M_face->generation;
+	}
+
+	auto &cache = run_cache::get();
 
-	face.load(get_library(), data, size);
+	{
+		std::lock_guard lock(cache.mutex);
+
+		auto it = cache.runs.find(key);
+		if (it != cache.runs.end())
+			if (auto existing = it->second.lock(); existing && existing->str.view() == str)
+				return existing;
+	}
+
+	// laid out without holding the cache's lock, an identical run laid out meanwhile is simply replaced
+	auto res = std::make_shared<shaped_run>();
+	res->str.assign(str);
+	res->face = M_face;
+
+	res->layout.set_max_width(key.max_width);
+	res->layout.set_line_height(key.line_height);
+	res->layout.set_alignment(key.align);
+	res->layout.update(*this, res->str);
 
-	face.size = height;
-	face.resize();
+	res->pens.resize(str.size());
+
+	float baseline = 0;
+	for (const auto &line : res->layout.lines())
+	{
+		// remove first character's horizontal offset
+		float pen = res->layout.line_offset(line) - line.bearing;
+
+		for (std::size_t i = line.begin; i < line.end; ++i)
+		{
+			res->pens[i] = { pen, baseline };
+			pen += pen_advance(*at(str[i]));
+		}
+
+		baseline -= res->layout.line_advance();
+	}
+
+	std::lock_guard lock(cache.mutex);
+	cache.insert(key, res);
+
+	return res;
 }
 
-font::character::character(const font *_font, uint32_t c) : text{}, offset{}, advance{}, height{}
+std::size_t font::registry_size()
 {
-	load(_font, c);
+	auto &registry = font_registry::get();
+	std::lock_guard lock(registry.mutex);
+
+	return std::count_if(registry.faces.begin(), registry.faces.end(), [](const auto &entry) { return !entry.second.expired(); });
 }
 
-font::character::character(character &&other) noexcept : text{ std::move(other.text) }, offset{ other.offset }, advance{ other.advance }, height{ other.height }
+unsigned int font::get_line_spacing() const
 {
-	other.offset = {};
-	other.height = {};
-	other.advance = {};
+	auto &face = M_face->face;
+	if (!face.face || !face.face->size)
+		return face.size;
+	return static_cast<unsigned int>(face.face->size->metrics.height >> 6);
 }
 
-font::character &font::character::operator=(font::character &&other) noexcept
+unsigned int font::get_ascender() const
 {
-	text.destroy();
+	auto &face = M_face->face;
+	if (!face.face || !face.face->size)
+		return face.size;
+	return static_cast<unsigned int>(face.face->size->metrics.ascender >> 6);
+}
 
-	text = std::move(other.text);
-	offset = other.offset;
-	advance = other.advance;
-	height = other.height;
+font::glyph_metrics font::get_metrics(uint32_t c) const
+{
+	return *at(c);
+}
 
-	other.offset = {};
-	other.height = {};
-	other.advance = {};
+bound font::measure(code_point_view str) const
+{
+	paragraph_layout layout;
+	layout.update(*this, str);
+	return layout.bounds();
+}
 
-	return *this;
+bound font::measure(std::string_view str) const
+{
+	std::basic_string<uint32_t> decoded;
+	detail::decode_utf8(str, decoded);
+	return measure(decoded);
+}
+
+static bool has_character(FT_Face face, uint32_t c)
+{
+	return face && FT_Get_Char_Index(face, c);
 }
 
-void font::character::load(const font *_font, uint32_t c)
+// full hinting snaps stems and advances to whole pixels, which would undo subpixel positioning, so subpixel glyphs are only hinted vertically
+static FT_Int32 load_flags(unsigned int subpixel)
 {
-	height = _font->get_character_height();
+	return subpixel > 1 ? FT_LOAD_TARGET_LIGHT : FT_LOAD_DEFAULT;
+}
 
-	FT_Face face = _font->face.face;
-	if (FT_Load_Char(face, c, FT_LOAD_RENDER))
+static void load_metrics(FT_Face face, uint32_t c, unsigned int subpixel, font::glyph_metrics &res)
+{
+	if (FT_Load_Char(face, c, load_flags(subpixel)))
 	{
 		detail::log_error(error("Couldn't load character", error_code::freetype_invalid_character));
 		return;
 	}
-	text.load(GL_RGBA, face->glyph->bitmap.buffer, face->glyph->bitmap.width, face->glyph->bitmap.rows, 1);
-	offset.x = face->glyph->bitmap_left;
-	offset.y = face->glyph->bitmap_top;
-	advance = face->glyph->advance.x;
 
-	text.set_parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	text.set_parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	text.set_parameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	text.set_parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	auto *glyph = face->glyph;
+
+	// the unhinted advance keeps its fraction (16.16 to 26.6)
+	if (subpixel > 1)
+		res.advance = static_cast<unsigned int>(glyph->linearHoriAdvance >> 10);
+	else
+		res.advance = static_cast<unsigned int>(glyph->advance.x);
+
+	if (glyph->format == FT_GLYPH_FORMAT_OUTLINE)
+	{
+		// the same pixel aligned box the rasterizer places the bitmap in
+		FT_BBox box;
+		FT_Outline_Get_CBox(&glyph->outline, &box);
+
+		box.xMin &= ~63;
+		box.yMin &= ~63;
+		box.xMax = (box.xMax + 63) & ~63;
+		box.yMax = (box.yMax + 63) & ~63;
+
+		res.offset.x = static_cast<int>(box.xMin >> 6);
+		res.offset.y = static_cast<int>(box.yMax >> 6);
+		res.size.x = static_cast<int>((box.xMax - box.xMin) >> 6);
+		res.size.y = static_cast<int>((box.yMax - box.yMin) >> 6);
+	}
+	else
+	{
+		res.offset.x = glyph->bitmap_left;
+		res.offset.y = glyph->bitmap_top;
+		res.size.x = static_cast<int>(glyph->bitmap.width);
+		res.size.y = static_cast<int>(glyph->bitmap.rows);
+	}
+}
+
+void font::character::load_variants(FT_FaceRec_ *src, unsigned int count)
+{
+	for (unsigned int i = 1; i < count; ++i)
+	{
+		auto &variant = variants[i - 1];
+		variant.offset_x = offset.x;
+		variant.width = size.x;
+
+		if (!src || src->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
+			continue;
+
+		// the same box as load_metrics, for the outline shifted by i / count pixels
+		FT_BBox box;
+		FT_Outline_Get_CBox(&src->glyph->outline, &box);
 
-	static vec4 transparent{0, 0, 0, 0};
+		FT_Pos shift = static_cast<FT_Pos>(i * 64 / count);
+		FT_Pos x_min = (box.xMin + shift) & ~63;
+		FT_Pos x_max = (box.xMax + shift + 63) & ~63;
 
-	text.set_parameter(GL_TEXTURE_BORDER_COLOR, value(transparent));
+		variant.offset_x = static_cast<int>(x_min >> 6);
+		variant.width = static_cast<int>((x_max - x_min) >> 6);
+	}
+}
+
+void font::character::load(shared_face &_face, uint32_t c)
+{
+	std::vector<std::shared_ptr<shared_face>> fallbacks;
+	unsigned int count;
+
+	{
+		std::lock_guard lock(_face.mutex);
+
+		count = _face.subpixel;
+
+		if (_face.fallbacks.empty() || has_character(_face.face.face, c))
+		{
+			face = 0;
+			load_metrics(_face.face.face, c, count, *this);
+			load_variants(_face.face.face, count);
+			return;
+		}
+
+		fallbacks = _face.fallbacks;
+	}
+
+	// one face is locked at a time, so chains that loop back can't deadlock
+	for (std::size_t i = 0; i < fallbacks.size(); ++i)
+	{
+		auto &fallback = *fallbacks[i];
+		std::lock_guard lock(fallback.mutex);
+
+		if (has_character(fallback.face.face, c))
+		{
+			face = static_cast<uint8_t>(i + 1);
+			load_metrics(fallback.face.face, c, count, *this);
+			load_variants(fallback.face.face, count);
+			return;
+		}
+	}
+
+	// no face has it, use the primary face's missing glyph
+	std::lock_guard lock(_face.mutex);
+	face = 0;
+	load_metrics(_face.face.face, c, count, *this);
+	load_variants(_face.face.face, count);
+}
+
+void font::character::render(shared_face &_face, uint32_t c, unsigned int variant)
+{
+	std::shared_ptr<shared_face> fallback;
+	unsigned int count;
+
+	{
+		std::lock_guard lock(_face.mutex);
+		count = _face.subpixel;
+		if (face && face <= _face.fallbacks.size())
+			fallback = _face.fallbacks[face - 1];
+	}
+
+	auto &src = fallback ? *fallback : _face;
+	std::lock_guard lock(src.mutex);
+
+	if (FT_Load_Char(src.face.face, c, load_flags(count) | (variant ? 0 : FT_LOAD_RENDER)))
+	{
+		detail::log_error(error("Couldn't load character", error_code::freetype_invalid_character));
+		return;
+	}
+
+	if (variant)
+	{
+		auto *glyph = src.face.face->glyph;
+		if (glyph->format == FT_GLYPH_FORMAT_OUTLINE)
+			FT_Outline_Translate(&glyph->outline, static_cast<FT_Pos>(variant * 64 / count), 0);
+
+		if (FT_Render_Glyph(glyph, FT_RENDER_MODE_NORMAL))
+		{
+			detail::log_error(error("Couldn't render character", error_code::freetype_invalid_character));
+			return;
+		}
+	}
+
+	// the atlas copies the bitmap, rows stay top to bottom
+	auto &bitmap = src.face.face->glyph->bitmap;
+	if (!bitmap.width || !bitmap.rows)
+		return;
+
+	// fallback glyphs go into the primary face's atlas too
+	_face.atlas.insert(slot_of(variant), bitmap.buffer, static_cast<int>(bitmap.width), static_cast<int>(bitmap.rows), bitmap.pitch);
+}
+
+void font::add_fallback(const font &fallback)
+{
+	if (fallback.M_face == M_face)
+	{
+		detail::log_error(error("A font can't be its own fallback.", error_code::invalid_argument));
+		return;
+	}
+
+	std::lock_guard lock(M_face->mutex);
+
+	if (M_face->fallbacks.size() >= max_fallbacks)
+	{
+		detail::log_error(error("Too many fallback fonts.", error_code::invalid_argument));
+		return;
+	}
+
+	M_face->fallbacks.push_back(fallback.M_face);
+
+	// code points may now resolve to a different face
+	++M_face->generation;
+	M_face->atlas.clear();
+	M_face->chars.clear();
+}
+
+void font::clear_fallbacks()
+{
+	std::lock_guard lock(M_face->mutex);
+
+	if (M_face->fallbacks.empty())
+		return;
+
+	M_face->fallbacks.clear();
+	++M_face->generation;
+	M_face->atlas.clear();
+	M_face->chars.clear();
+}
+
+uint64_t font::get_generation() const
+{
+	std::lock_guard lock(M_face->mutex);
+	return M_face->generation;
+}
+
+std::size_t font::fallback_count() const
+{
+	std::lock_guard lock(M_face->mutex);
+	return M_face->fallbacks.size();
+}
+
+void font::set_subpixel_variants(unsigned int count)
+{
+	count = std::clamp(count, 1u, max_subpixel_variants);
+
+	std::lock_guard lock(M_face->mutex);
+
+	if (M_face->subpixel == count)
+		return;
+
+	// advances and variant extents are loaded for the count, so every glyph is loaded again
+	M_face->subpixel = count;
+	++M_face->generation;
+	M_face->atlas.clear();
+	M_face->chars.clear();
+}
+
+unsigned int font::get_subpixel_variants() const
+{
+	std::lock_guard lock(M_face->mutex);
+	return M_face->subpixel;
 }
 
 namespace text_detail
@@ -160,20 +609,23 @@ namespace text_detail
 			"uniform mat4 SGUI_Ortho;"
 			"uniform mat4 SGUI_Model;"
 			"out vec2 SGUI_VertTextPos;"
+			"out vec4 SGUI_VertColor;"
 			"layout (location = " STR(pos_loc) ") in vec2 SGUI_Pos;"
+			"layout (location = " STR(color_loc) ") in vec4 SGUI_Color;"
 			"layout (location = " STR(textPos_loc) ") in vec2 SGUI_TextPos;"
 			"void main() {"
 			"	gl_Position = SGUI_Ortho * SGUI_Model * vec4(SGUI_Pos, 0.0, 1.0);"
 			"	SGUI_VertTextPos = SGUI_TextPos;"
+			"	SGUI_VertColor = SGUI_Color;"
 			"}";
 		static std::string fragment_source =
 			"#version 410 core\n"
-			"uniform vec4 SGUI_Color;"
 			"uniform sampler2D SGUI_Texture;"
 			"out vec4 SGUI_OutColor;"
 			"in vec2 SGUI_VertTextPos;"
+			"in vec4 SGUI_VertColor;"
 			"void main() {"
-			"	SGUI_OutColor = vec4(SGUI_Color.xyz, SGUI_Color.w * texture(SGUI_Texture, SGUI_VertTextPos).r);"
+			"	SGUI_OutColor = vec4(SGUI_VertColor.xyz, SGUI_VertColor.w * texture(SGUI_Texture, SGUI_VertTextPos).r);"
 			"}";
 		static shader res = []()
 		{
@@ -184,63 +636,69 @@ namespace text_detail
 		return res;
 	}
 
-	class char_obj
+	void glyph_batch::draw(shader &program, const mat4 &model) const
 	{
-	public:
-		void draw()
+		static std::vector<vertex> vertices;
+		vertices.clear();
+
+		for (const auto &cur : M_runs)
+			vertices.insert(vertices.end(), cur.vertices.begin(), cur.vertices.end());
+
+		if (vertices.empty())
+			return;
+
+		static vbo points;
+		static vao buffer = [&]()
 		{
-			model = translate(M_loc);
+			vao res;
+			res.generate();
+			points.generate();
 
-			if (M_angle != 0)
-			{
-				if (M_origin != vec3{})
-				{
-					model *= translate(M_origin);
-					model *= rot(M_angle, M_axis);
-					model *= translate(-M_origin);
-				}
-				else
-					model *= rot(M_angle, M_axis);
-			}
+			detail::vao_lock lvao;
+			detail::vbo_lock lvbo;
 
-			glDisable(GL_CULL_FACE);
+			res.use();
+			points.use();
 
-			static vao buffer = detail::make_shape_vao(detail::rect_obj_vbo(), &detail::text_pos_vbo());
+			glEnableVertexAttribArray(pos_loc);
+			glVertexAttribPointer(pos_loc, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, pos));
+			glEnableVertexAttribArray(textPos_loc);
+			glVertexAttribPointer(textPos_loc, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, uv));
+			glEnableVertexAttribArray(color_loc);
+			glVertexAttribPointer(color_loc, 4, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, color));
 
-			static auto &program = text_detail::get_shader();
-			program.set_uniform("SGUI_Model", model);
-			program.set_uniform("SGUI_Texture", *M_texture);
+			return res;
+		}();
 
-			program.bind();
+		// orphans last frame's storage instead of waiting on it
+		points.attach_data(vertices, GL_STREAM_DRAW);
 
-			{
-				auto pos_vbo = buffer.get_attribute(pos_loc);
-				auto data = pos_vbo. template get_data<vec2>(GL_WRITE_ONLY);
-
-				data[0] = {};
-				data[1].x = M_sz.x;
-				data[1].y = 0;
-				data[2] = M_sz;
-				data[3].x = 0;
-				data[3].y = M_sz.y;
-			}
+		glDisable(GL_CULL_FACE);
 
-			buffer.use();
-			glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+		program.set_uniform("SGUI_Model", model);
+		buffer.use();
+
+		GLint first = 0;
+		for (const auto &cur : M_runs)
+		{
+			auto count = static_cast<GLsizei>(cur.vertices.size());
+			if (!count)
+				continue;
+
+			program.set_uniform("SGUI_Texture", *cur.text);
+			program.bind();
+
+			glDrawArrays(GL_TRIANGLES, first, count);
+			first += count;
 		}
-		
-		mat4 model;
-		vec3 M_origin;
-		vec3 M_axis;
-		vec3 M_loc;
-		vec2 M_sz;
-		float M_angle;
-		const texture *M_texture;
-	};
+	}
 }
 
 void text::draw_raw(const window *win, vec2 absolute_min) const
 {
+	if (!M_font)
+		return;
+
 	detail::blend_lock lock;
 	detail::cull_face_lock clock;
 	detail::shader_lock slock;
@@ -248,45 +706,107 @@ void text::draw_raw(const window *win, vec2 absolute_min) const
 	detail::fbo_lock flock;
 
 	static auto &program = text_detail::get_shader();
-	program.set_uniform("SGUI_Color", M_col);
 	program.set_uniform("SGUI_Ortho", win->ortho());
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	auto *cur = M_font->at(M_data.front());
+	update_bounds();
+
+	static text_detail::glyph_batch batch;
+	batch.clear();
 
-	// remove first character's horizontal offset
-	auto origin = M_origin + absolute_min;
-	origin.x -= cur->offset.x * M_scale.x;
+	auto baseline = M_origin + absolute_min;
+
+	if (M_run)
+	{
+		// pens are shared with every text drawing the same run, only the glyph's variant, residency and colour are looked up
+		for (const auto &line : M_run->layout.lines())
+		{
+			for (std::size_t i = line.begin; i < line.end; ++i)
+			{
+				auto &pen = M_run->pens[i];
 
-	text_detail::char_obj cspr{.model = {}, .M_origin = {}, .M_axis = { 0, 0, 1 }, .M_loc = {}, .M_sz = {}, .M_angle = M_angle };
+				auto cur = M_font->rendered_at(M_run->str[i], pen.x);
+				if (!cur.slot->page)
+					continue;
 
-	auto rot_origin = vec3(M_rot_origin, 0);
+				vec2 size(cur.size);
+				vec2 min = baseline + vec2(cur.left, pen.y + cur.ch->offset.y - size.y) * M_scale;
 
-	for (uint32_t c : M_data)
+				batch.add(*cur.slot, min, min + size * M_scale, cur.size, color_at(i));
+			}
+		}
+	}
+	else
 	{
-		cur = M_font->at(c);
+		for (const auto &line : M_layout.lines())
+		{
+			// remove first character's horizontal offset
+			float pen = M_layout.line_offset(line) - line.bearing;
 
-		cspr.M_texture = &cur->text;
+			for (std::size_t i = line.begin; i < line.end; ++i)
+			{
+				auto *span = find_span(M_spans, i);
+				auto &src = span && span->fnt ? *span->fnt : *M_font;
+				float span_scale = span ? span->scale : 1;
 
-		vec2 sz(cur->text.get_width(), cur->text.get_height());
-		vec3 cur_loc = { origin, 0 };
-		cur_loc.x += cur->offset.x * M_scale.x;
-		cur_loc.y += (cur->offset.y - sz.y) * M_scale.y;
+				// variants are picked in the glyph's own pixels, which a span's scale stretches
+				auto cur = src.rendered_at(M_data[i], pen / span_scale);
 
-		origin.x += (cur->advance >> 6) * M_scale.x;
+				if (cur.slot->page)
+				{
+					vec2 size(cur.size);
+					vec2 min = { cur.left * span_scale, (cur.ch->offset.y - size.y) * span_scale };
 
-		cspr.M_loc = cur_loc;
-		cspr.M_sz = sz * M_scale;
+					min = baseline + min * M_scale;
+					batch.add(*cur.slot, min, min + size * span_scale * M_scale, cur.size, span ? span->color : M_col);
+				}
 
-		cspr.M_origin = rot_origin - cur_loc;
+				pen += src.pen_advance(*cur.ch) * span_scale;
+			}
 
-		cspr.draw();
+			baseline.y -= M_layout.line_advance() * M_scale.y;
+		}
 	}
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	mat4 model = identity();
+	if (M_angle != 0)
+	{
+		auto rot_origin = vec3(M_rot_origin, 0);
+
+		model *= translate(rot_origin);
+		model *= rot(M_angle, vec3{ 0, 0, 1 });
+		model *= translate(-rot_origin);
+	}
+
+	batch.draw(program, model);
+}
+
+void text::set_string(std::basic_string_view<char> txt)
+{
+	// ascii is already stored one byte per character, so it's copied as is
+	if (std::all_of(txt.begin(), txt.end(), [](char c) { return static_cast<unsigned char>(c) < 0x80; }))
+		M_data.assign(code_point_view(txt.data(), txt.size(), 1));
+	else
+	{
+		std::basic_string<uint32_t> decoded;
+		if (!detail::decode_utf8(txt, decoded))
+			detail::log_error(error("Malformed utf-8 in text string.", error_code::invalid_encoding));
+		M_data.assign(decoded);
+	}
+
+	M_layout.invalidate();
+}
+
+void text::set_string(std::basic_string_view<wchar_t> txt)
+{
+	std::basic_string<uint32_t> decoded;
+	if (!detail::decode_wide(std::wstring_view(txt.data(), txt.size()), decoded))
+		detail::log_error(error("Malformed wide string in text string.", error_code::invalid_encoding));
+
+	M_data.assign(decoded);
+	M_layout.invalidate();
 }
 
 bound text::get_local_rect() const
@@ -303,51 +823,120 @@ bound text::get_local_rect() const
 
 void text::update_bounds() const
 {
-	if (!M_data_changed)
+	if (!M_font)
 		return;
 
-	M_data_changed = false;
+	// fallbacks or subpixel variants changed since the layout was built, so its advances and the shared run are stale
+	if (uint64_t generation = font_generation(); generation != M_generation)
+	{
+		M_generation = generation;
+		M_run.reset();
+		M_layout.invalidate();
+	}
+
+	if (!M_layout.needs_update())
+		return;
 
-	bound res{};
+	bool styled = std::any_of(M_spans.begin(), M_spans.end(), [](const text_span &span) { return span.affects_layout(); });
 
-	if (M_data.empty())
+	if (M_layout.needs_full_update() && M_data.size() <= max_shared_run && !styled)
 	{
-		M_bound = res;
-		return;
+		// the text doesn't keep a layout of its own while it shares a run
+		M_run = M_font->shape(M_data, M_layout);
+		M_layout.reset();
+	}
+	else
+	{
+		M_run.reset();
+		M_layout.update(*M_font, M_data, styled ? std::span<const text_span>(M_spans) : std::span<const text_span>());
 	}
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	M_bound = layout().bounds();
+}
 
-	vec2 max{ -M_font->at(M_data.front())->offset.x, 0 };
+uint64_t text::font_generation() const
+{
+	// generations only grow, so their sum changes whenever one of them does
+	uint64_t res = M_font->get_generation();
+	for (const auto &span : M_spans)
+		if (span.fnt && !span.fnt->shares_face(*M_font))
+			res += span.fnt->get_generation();
 
-	auto end = M_data.end() - 1;
+	return res;
+}
+
+void text::add_span(const text_span &span)
+{
+	if (span.begin >= span.end)
+		return;
 
-	font::character const *cur;
+	if (span.affects_layout() || std::any_of(M_spans.begin(), M_spans.end(), [&span](const text_span &cur) { return cur.affects_layout() && cur.begin < span.end && span.begin < cur.end; }))
+		M_layout.invalidate();
 
-	for (auto it = M_data.begin(); it != end; ++it)
+	// spans never overlap, so the part of any span under the new one is cut out of it
+	std::vector<text_span> res;
+	res.reserve(M_spans.size() + 2);
+
+	for (const auto &cur : M_spans)
 	{
-		cur = M_font->at(*it);
-		max.x += cur->advance >> 6;
+		if (cur.end <= span.begin || cur.begin >= span.end)
+		{
+			res.push_back(cur);
+			continue;
+		}
 
-		if (float pot = (float)cur->offset.y - cur->text.get_height(); pot < res.min.y)
-			res.min.y = pot;
-		if (cur->offset.y > max.y)
-			max.y = (float)cur->offset.y;
+		if (cur.begin < span.begin)
+		{
+			res.push_back(cur);
+			res.back().end = span.begin;
+		}
+		if (cur.end > span.end)
+		{
+			res.push_back(cur);
+			res.back().begin = span.end;
+		}
 	}
 
-	cur = M_font->at(*end);
-	max.x += cur->offset.x + cur->text.get_width();
+	res.insert(std::upper_bound(res.begin(), res.end(), span.begin, [](std::size_t pos, const text_span &cur) { return pos < cur.begin; }), span);
+	M_spans = std::move(res);
+}
 
-	if (float pot = (float)cur->offset.y - cur->text.get_height(); pot < res.min.y)
-		res.min.y = pot;
-	if (cur->offset.y > max.y)
-		max.y = (float)cur->offset.y;
+void text::clear_spans()
+{
+	if (std::any_of(M_spans.begin(), M_spans.end(), [](const text_span &span) { return span.affects_layout(); }))
+		M_layout.invalidate();
 
-	res.dims = max - res.min;
+	M_spans.clear();
+}
 
-	M_bound = res;
+void text::shift_spans(std::size_t pos, std::size_t removed, std::size_t inserted)
+{
+	if (M_spans.empty())
+		return;
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	// characters inserted inside a span take its style, removed ones shrink it
+	auto shift = [=](std::size_t cur)
+	{
+		if (cur <= pos)
+			return cur;
+		if (cur >= pos + removed)
+			return cur - removed + inserted;
+		return pos;
+	};
+
+	for (auto &span : M_spans)
+	{
+		span.begin = shift(span.begin);
+		span.end = shift(span.end);
+	}
+
+	std::erase_if(M_spans, [](const text_span &span) { return span.begin >= span.end; });
+}
+
+vec4 text::color_at(std::size_t pos) const
+{
+	auto *span = find_span(M_spans, pos);
+	return span ? span->color : M_col;
 }
 
 void text::obj_init()
@@ -0,0 +1,96 @@
+#ifndef TEXT_DETAIL_H
+#define TEXT_DETAIL_H
+#include "macro.h"
+#include "help.h"
+
+#include "math/mat.h"
+#include "graphics/texture.h"
+#include "graphics/glyph_atlas.h"
+#include "graphics/shaders.h"
+
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+SGUI_BEG
+
+namespace text_detail
+{
+	shader &get_shader();
+
+	// collects the quads of a draw's glyphs, grouped by atlas page, and draws them with one upload and one call per page
+	// glyphs from several fonts and colours still end up in the same call when they share a page
+	class glyph_batch
+	{
+	public:
+		// starts a new atlas batch, so pages used by the previous one may be evicted again
+		void clear()
+		{
+			detail::glyph_atlas::begin_batch();
+
+			// pages that weren't drawn last batch may have been evicted, the rest keep their storage
+			std::erase_if(M_runs, [](const run &cur) { return cur.vertices.empty(); });
+			for (auto &cur : M_runs)
+				cur.vertices.clear();
+		}
+
+		// min and max are the corners of the glyph's quad, size the dimensions of its bitmap
+		void add(const detail::atlas_slot &slot, vec2 min, vec2 max, ivec2 size, vec4 color)
+		{
+			auto &vertices = run_of(&slot.page->text).vertices;
+
+			float dim = static_cast<float>(slot.page->dim);
+			vec2 uv_min = vec2(slot.pos) / dim;
+			vec2 uv_max = vec2(slot.pos + size) / dim;
+
+			// atlas rows go top to bottom
+			vertex quad[] = {
+				{ min, { uv_min.x, uv_max.y }, color },
+				{ { max.x, min.y }, uv_max, color },
+				{ max, { uv_max.x, uv_min.y }, color },
+				{ min, { uv_min.x, uv_max.y }, color },
+				{ max, { uv_max.x, uv_min.y }, color },
+				{ { min.x, max.y }, uv_min, color },
+			};
+
+			vertices.insert(vertices.end(), std::begin(quad), std::end(quad));
+		}
+
+		// expects the text shader's other uniforms to be set
+		void draw(shader &program, const mat4 &model) const;
+
+	private:
+		struct vertex
+		{
+			vec2 pos;
+			vec2 uv;
+			vec4 color;
+		};
+
+		struct run
+		{
+			const texture *text;
+			std::vector<vertex> vertices;
+		};
+
+		std::vector<run> M_runs;
+		std::size_t M_last = 0;
+
+		run &run_of(const texture *text)
+		{
+			if (M_last < M_runs.size() && M_runs[M_last].text == text)
+				return M_runs[M_last];
+
+			auto it = std::find_if(M_runs.begin(), M_runs.end(), [text](const run &cur) { return cur.text == text; });
+			if (it == M_runs.end())
+				it = M_runs.insert(M_runs.end(), run{ .text = text, .vertices = {} });
+
+			M_last = it - M_runs.begin();
+			return *it;
+		}
+	};
+}
+
+SGUI_END
+
+#endif
\ No newline at end of file
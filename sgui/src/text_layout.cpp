@@ -0,0 +1,382 @@
+#include "gui/text_layout.h"
+#include "gui/text.h"
+
+#include <algorithm>
+#include <limits>
+
+SGUI_BEG
+
+inline bool is_break_space(uint32_t c)
+{
+	return c == ' ' || c == '\t';
+}
+
+void paragraph_layout::invalidate(std::size_t pos, std::size_t removed, std::size_t inserted)
+{
+	if (M_dirty == dirty_state::full)
+		return;
+
+	if (M_dirty == dirty_state::clean)
+	{
+		M_dirty_begin = pos;
+		M_dirty_end = pos + inserted;
+		M_dirty_delta = static_cast<std::ptrdiff_t>(inserted) - static_cast<std::ptrdiff_t>(removed);
+		M_dirty = dirty_state::partial;
+		return;
+	}
+
+	// move the old dirty end into the coordinates of the edited string
+	std::size_t end = M_dirty_end;
+	if (end >= pos + removed)
+		end = end + inserted - removed;
+	else if (end > pos)
+		end = pos + inserted;
+
+	M_dirty_begin = std::min(M_dirty_begin, pos);
+	M_dirty_end = std::max(end, pos + inserted);
+	M_dirty_delta += static_cast<std::ptrdiff_t>(inserted) - static_cast<std::ptrdiff_t>(removed);
+}
+
+paragraph_layout::glyph_box paragraph_layout::glyph_source::at(code_point_view str, std::size_t i) const
+{
+	const font *src = &fnt;
+	float scale = 1;
+
+	if (auto *span = find_span(spans, i))
+	{
+		if (span->fnt)
+			src = span->fnt;
+		scale = span->scale;
+	}
+
+	auto *cur = src->at(str[i]);
+	return { vec2(cur->offset) * scale, vec2(cur->size) * scale, src->pen_advance(*cur) * scale };
+}
+
+void paragraph_layout::update(const font &_font, code_point_view str, std::span<const text_span> spans)
+{
+	float spacing = static_cast<float>(_font.get_line_spacing());
+	for (const auto &span : spans)
+		if (span.affects_layout())
+			spacing = std::max(spacing, static_cast<float>((span.fnt ? span.fnt : &_font)->get_line_spacing()) * span.scale);
+
+	glyph_source glyphs{ _font, spans };
+
+	float advance = M_line_height * spacing;
+	if (advance != M_line_advance)
+	{
+		M_line_advance = advance;
+		M_valid_extents = 0;
+		M_dirty_bounds = true;
+	}
+
+	if (M_dirty == dirty_state::partial && !M_lines.empty())
+	{
+		// move the per character data into the coordinates of the edited string
+		std::size_t old_end = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(M_dirty_end) - M_dirty_delta);
+		M_chars.erase(M_chars.begin() + M_dirty_begin, M_chars.begin() + old_end);
+		M_chars.insert(M_chars.begin() + M_dirty_begin, M_dirty_end - M_dirty_begin, char_extent{});
+
+		// the first line that contains a dirty character
+		auto it = std::upper_bound(M_lines.begin(), M_lines.end(), M_dirty_begin, [](std::size_t pos, const line_box &line) { return pos < line.next; });
+		std::size_t first = it == M_lines.end() ? M_lines.size() - 1 : it - M_lines.begin();
+
+		// an edit at the start of a line can pull a word back onto the previous line, which only happens when wrapping
+		layout_from(glyphs, str, first && M_max_width > 0 ? first - 1 : first, M_lines[first].begin);
+	}
+	else if (M_dirty != dirty_state::clean || M_lines.empty())
+	{
+		M_dirty = dirty_state::full;
+		M_lines.clear();
+		M_chars.assign(str.size(), char_extent{});
+		layout_from(glyphs, str, 0, 0);
+	}
+
+	M_dirty = dirty_state::clean;
+
+	if (M_dirty_bounds)
+		update_bounds();
+}
+
+void paragraph_layout::layout_from(const glyph_source &glyphs, code_point_view str, std::size_t first_line, std::size_t resume_begin)
+{
+	bool partial = M_dirty == dirty_state::partial;
+
+	std::size_t begin = first_line < M_lines.size() ? M_lines[first_line].begin : 0;
+
+	std::vector<line_box> relaid;
+	std::size_t resume = M_lines.size();
+
+	for (;;)
+	{
+		// characters of the edited line in front of the edit keep their pen positions
+		std::size_t unchanged = partial && begin == resume_begin ? std::clamp(M_dirty_begin, begin, str.size()) : begin;
+
+		bool newline;
+		line_box line = layout_line(glyphs, str, begin, unchanged, newline);
+		relaid.push_back(line);
+
+		if (line.next >= str.size())
+		{
+			// a trailing newline starts an empty last line
+			if (newline)
+			{
+				line_box empty{ str.size(), str.size(), str.size(), 0, 0, 0, 0 };
+				relaid.push_back(empty);
+			}
+			break;
+		}
+
+		begin = line.next;
+
+		// once a line starts past the edit at the same place an old line started, the rest of the old layout is still valid
+		if (partial && begin >= M_dirty_end)
+		{
+			std::size_t old_begin = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(begin) - M_dirty_delta);
+
+			auto it = std::lower_bound(M_lines.begin() + first_line + 1, M_lines.end(), old_begin, [](const line_box &line, std::size_t pos) { return line.begin < pos; });
+			if (it != M_lines.end() && it->begin == old_begin)
+			{
+				resume = it - M_lines.begin();
+				break;
+			}
+		}
+	}
+
+	// shift the reused lines into the new string's coordinates
+	for (std::size_t i = resume; i < M_lines.size(); ++i)
+	{
+		auto &line = M_lines[i];
+		line.begin += M_dirty_delta;
+		line.end += M_dirty_delta;
+		line.next += M_dirty_delta;
+	}
+
+	auto first = M_lines.begin() + std::min(first_line, M_lines.size());
+	first = M_lines.erase(first, M_lines.begin() + resume);
+	M_lines.insert(first, relaid.begin(), relaid.end());
+
+	M_valid_extents = std::min(M_valid_extents, first_line);
+	M_dirty_bounds = true;
+}
+
+line_box paragraph_layout::layout_line(const glyph_source &glyphs, code_point_view str, std::size_t begin, std::size_t resume, bool &newline)
+{
+	line_box line{ begin, str.size(), str.size(), 0, 0, 0, 0 };
+	newline = false;
+
+	// end of the last word that fits and start of the word after it
+	std::size_t break_end = begin;
+	std::size_t break_next = begin;
+
+	float pen = 0;
+	float min_y = 0;
+	float max_y = 0;
+
+	if (resume > begin)
+	{
+		line.bearing = glyphs.at(str, begin).offset.x;
+
+		auto &prev = M_chars[resume - 1];
+		pen = prev.pen;
+		min_y = prev.min_y;
+		max_y = prev.max_y;
+
+		// the last run of spaces in front of resume. Only used when wrapping, where lines are short
+		std::size_t i = M_max_width > 0 ? resume : begin;
+		while (i > begin && !is_break_space(str[i - 1]))
+			--i;
+
+		if (i > begin)
+		{
+			break_next = i;
+			while (i > begin && is_break_space(str[i - 1]))
+				--i;
+			break_end = i;
+		}
+	}
+
+	for (std::size_t i = resume; i < str.size(); ++i)
+	{
+		uint32_t c = str[i];
+
+		if (c == '\n')
+		{
+			line.end = i;
+			line.next = i + 1;
+			newline = true;
+			break;
+		}
+
+		auto cur = glyphs.at(str, i);
+
+		if (i == begin)
+			line.bearing = cur.offset.x;
+
+		if (is_break_space(c))
+		{
+			if (i == begin || !is_break_space(str[i - 1]))
+				break_end = i;
+			break_next = i + 1;
+		}
+		else if (M_max_width > 0 && i != begin)
+		{
+			float right = pen - line.bearing + cur.offset.x + cur.size.x;
+			if (right > M_max_width)
+			{
+				if (break_end > begin)
+				{
+					line.end = break_end;
+					line.next = break_next;
+				}
+				// no space to break at, so break in the middle of the word
+				else
+					line.end = line.next = i;
+
+				// the characters scanned past the break start the next line, so their pens have to be relative to it
+				float next_pen = 0;
+				float next_min_y = 0;
+				float next_max_y = 0;
+
+				for (std::size_t j = line.next; j < i; ++j)
+				{
+					auto prev = glyphs.at(str, j);
+
+					next_pen += prev.advance;
+					next_min_y = std::min(next_min_y, prev.offset.y - prev.size.y);
+					next_max_y = std::max(next_max_y, prev.offset.y);
+
+					M_chars[j] = { next_pen, next_min_y, next_max_y };
+				}
+				break;
+			}
+		}
+
+		pen += cur.advance;
+		min_y = std::min(min_y, cur.offset.y - cur.size.y);
+		max_y = std::max(max_y, cur.offset.y);
+
+		M_chars[i] = { pen, min_y, max_y };
+	}
+
+	measure_line(glyphs, str, line);
+
+	return line;
+}
+
+void paragraph_layout::measure_line(const glyph_source &glyphs, code_point_view str, line_box &line) const
+{
+	line.width = line.min_y = line.max_y = 0;
+
+	if (line.begin == line.end)
+		return;
+
+	auto last = glyphs.at(str, line.end - 1);
+	auto &extent = M_chars[line.end - 1];
+
+	line.width = pen_before(line, line.end - 1) - line.bearing + last.offset.x + last.size.x;
+	line.min_y = extent.min_y;
+	line.max_y = extent.max_y;
+}
+
+float paragraph_layout::pen_before(const line_box &line, std::size_t pos) const
+{
+	return pos == line.begin ? 0 : M_chars[pos - 1].pen;
+}
+
+float paragraph_layout::line_offset(const line_box &line) const
+{
+	if (M_align == text_align::left)
+		return 0;
+
+	float width = M_max_width > 0 ? M_max_width : M_widest;
+
+	if (M_align == text_align::center)
+		return (width - line.width) / 2;
+	return width - line.width;
+}
+
+std::size_t paragraph_layout::line_of(std::size_t pos) const
+{
+	auto it = std::upper_bound(M_lines.begin(), M_lines.end(), pos, [](std::size_t pos, const line_box &line) { return pos < line.next; });
+	if (it == M_lines.end())
+		return M_lines.empty() ? 0 : M_lines.size() - 1;
+	return it - M_lines.begin();
+}
+
+float paragraph_layout::caret_x(std::size_t pos) const
+{
+	if (M_dirty != dirty_state::clean || M_lines.empty())
+		return 0;
+
+	auto &line = M_lines[line_of(pos)];
+
+	// carets past the end of a wrapped line sit at its end
+	pos = std::clamp(pos, line.begin, line.end);
+
+	return line_offset(line) - line.bearing + pen_before(line, pos);
+}
+
+std::size_t paragraph_layout::index_at(std::size_t line_index, float x) const
+{
+	if (M_dirty != dirty_state::clean || M_lines.empty())
+		return 0;
+
+	if (line_index >= M_lines.size())
+		return M_lines.back().end;
+
+	auto &line = M_lines[line_index];
+	float pen = x - line_offset(line) + line.bearing;
+
+	// the first character whose middle is past x, pens only increase along a line
+	std::size_t low = line.begin;
+	std::size_t high = line.end;
+
+	while (low < high)
+	{
+		std::size_t mid = low + (high - low) / 2;
+		if ((pen_before(line, mid) + M_chars[mid].pen) / 2 <= pen)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+void paragraph_layout::update_bounds()
+{
+	M_dirty_bounds = false;
+
+	M_extents.resize(M_lines.size());
+
+	for (std::size_t i = std::min(M_valid_extents, M_lines.size()); i < M_lines.size(); ++i)
+	{
+		auto &line = M_lines[i];
+		float y = -static_cast<float>(i) * M_line_advance;
+
+		line_extent prev = i ? M_extents[i - 1] : line_extent{ 0, 0, 0 };
+		M_extents[i] = { std::max(prev.widest, line.width), std::min(prev.min_y, y + line.min_y), std::max(prev.max_y, y + line.max_y) };
+	}
+
+	M_valid_extents = M_lines.size();
+
+	if (M_lines.empty())
+	{
+		M_widest = 0;
+		M_bound = {};
+		return;
+	}
+
+	auto &total = M_extents.back();
+	M_widest = total.widest;
+
+	// a line's horizontal extent only depends on its width, so the widest line spans every other one
+	line_box widest{};
+	widest.width = M_widest;
+
+	M_bound.min = { line_offset(widest), total.min_y };
+	M_bound.dims = { M_widest, total.max_y - total.min_y };
+}
+
+SGUI_END
@@ -0,0 +1,221 @@
+#include "gui/text_view.h"
+#include "gui/text.h"
+#include "gui/window.h"
+
+#include "utils/context_lock.h"
+#include "utils/utf.h"
+
+#include "help.h"
+#include "text_detail.h"
+
+#include <algorithm>
+#include <cmath>
+
+SGUI_BEG
+
+void text_view::append_line(std::string_view line)
+{
+	for (;;)
+	{
+		auto newline = line.find('\n');
+		push_line(line.substr(0, newline));
+
+		if (newline == std::string_view::npos)
+			break;
+		line.remove_prefix(newline + 1);
+	}
+
+	if (M_max_lines && line_count() > M_max_lines)
+		drop_lines(line_count() - M_max_lines);
+}
+
+void text_view::push_line(std::string_view line)
+{
+	M_starts.push_back(M_bytes.size());
+	M_bytes.append(line);
+}
+
+void text_view::drop_lines(std::size_t count)
+{
+	M_first += count;
+	M_scroll = std::max(M_scroll - static_cast<float>(count), 0.f);
+
+	// compact once the dropped lines outnumber the live ones, so dropping stays amortized O(1)
+	if (M_first > line_count())
+	{
+		std::size_t offset = M_first < M_starts.size() ? M_starts[M_first] : M_bytes.size();
+
+		M_bytes.erase(0, offset);
+		M_starts.erase(M_starts.begin(), M_starts.begin() + M_first);
+		for (auto &start : M_starts)
+			start -= offset;
+
+		M_first = 0;
+	}
+}
+
+void text_view::clear()
+{
+	M_bytes.clear();
+	M_starts.clear();
+	M_first = 0;
+	M_scroll = 0;
+}
+
+std::string_view text_view::line(std::size_t i) const
+{
+	i += M_first;
+	std::size_t end = i + 1 < M_starts.size() ? M_starts[i + 1] : M_bytes.size();
+	return std::string_view(M_bytes).substr(M_starts[i], end - M_starts[i]);
+}
+
+void text_view::set_max_lines(std::size_t count)
+{
+	M_max_lines = count;
+	if (M_max_lines && line_count() > M_max_lines)
+		drop_lines(line_count() - M_max_lines);
+}
+
+void text_view::scroll_to(float line)
+{
+	float last = std::max(static_cast<float>(line_count()) - visible_lines(), 0.f);
+	M_scroll = std::clamp(line, 0.f, last);
+
+	// scrolling to the bottom resumes following the tail, and scrolling away stops it
+	M_follow_tail = M_scroll >= last;
+}
+
+float text_view::get_scroll() const
+{
+	if (M_follow_tail)
+		return std::max(static_cast<float>(line_count()) - visible_lines(), 0.f);
+	return M_scroll;
+}
+
+float text_view::line_advance() const
+{
+	return M_line_height * M_font->get_line_spacing();
+}
+
+float text_view::visible_lines() const
+{
+	float advance = line_advance();
+	return advance > 0 ? M_dims.y / advance : 0;
+}
+
+vec2 text_view::min() const
+{
+	return rectangle::min();
+}
+
+vec2 text_view::size() const
+{
+	return rectangle::size();
+}
+
+bool text_view::in_bounds(vec2 loc, vec2 absolute_min) const
+{
+	return rectangle::in_bounds(loc, absolute_min);
+}
+
+// clips to a box given in ortho units. glScissor takes framebuffer pixels, which differ from them on HiDPI screens and in offscreen targets,
+// so the box goes through the ortho matrix and the current viewport
+static void scissor(const mat4 &ortho, vec2 min, vec2 max)
+{
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	auto to_pixels = [&](vec2 loc)
+	{
+		auto ndc = ortho * vec4(loc.x, loc.y, 0.f, 1.f);
+		return vec2(viewport[0] + (ndc.x + 1.f) * 0.5f * viewport[2], viewport[1] + (ndc.y + 1.f) * 0.5f * viewport[3]);
+	};
+
+	vec2 a = to_pixels(min);
+	vec2 b = to_pixels(max);
+
+	auto left = static_cast<GLint>(std::floor(std::min(a.x, b.x)));
+	auto bottom = static_cast<GLint>(std::floor(std::min(a.y, b.y)));
+	auto right = static_cast<GLint>(std::ceil(std::max(a.x, b.x)));
+	auto top = static_cast<GLint>(std::ceil(std::max(a.y, b.y)));
+
+	glScissor(left, bottom, right - left, top - bottom);
+}
+
+void text_view::draw_raw(const window *win, vec2 absolute_min) const
+{
+	if (!win || !M_font || !line_count())
+		return;
+
+	detail::blend_lock lock;
+	detail::cull_face_lock clock;
+	detail::shader_lock slock;
+	detail::vao_lock vlock;
+	detail::scissor_lock sclock;
+
+	static auto &program = text_detail::get_shader();
+	program.set_uniform("SGUI_Ortho", win->ortho());
+
+	auto min = absolute_min + M_min;
+	auto max = min + M_dims;
+
+	glEnable(GL_SCISSOR_TEST);
+	scissor(win->ortho(), min, max);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	static text_detail::glyph_batch batch;
+	batch.clear();
+
+	float advance = line_advance();
+	float scroll = get_scroll();
+	float first = std::floor(scroll);
+
+	// baseline of the first (possibly partially scrolled out) line
+	float baseline = max.y - M_font->get_ascender() + (scroll - first) * advance;
+
+	std::size_t count = line_count();
+	for (std::size_t i = static_cast<std::size_t>(first); i < count && baseline + advance > min.y; ++i, baseline -= advance)
+	{
+		auto bytes = line(i);
+		const char *it = bytes.data();
+		const char *end = it + bytes.size();
+
+		float pen = min.x;
+
+		// remove first character's horizontal offset, like text does
+		if (it != end)
+		{
+			const char *first_char = it;
+			pen -= static_cast<float>(M_font->at(detail::decode_utf8(first_char, end))->offset.x);
+		}
+
+		while (it != end && pen < max.x)
+		{
+			auto cur = M_font->rendered_at(detail::decode_utf8(it, end), pen);
+
+			if (cur.slot->page)
+			{
+				vec2 sz(cur.size);
+				vec2 glyph_min = { cur.left, baseline + cur.ch->offset.y - sz.y };
+
+				batch.add(*cur.slot, glyph_min, glyph_min + sz, cur.size, M_col);
+			}
+
+			pen += M_font->pen_advance(*cur.ch);
+		}
+	}
+
+	batch.draw(program, identity());
+
+	for (const auto &child : M_children)
+		child->draw_raw(win, min);
+}
+
+void text_view::obj_init()
+{
+	rectangle::obj_init();
+}
+
+SGUI_END
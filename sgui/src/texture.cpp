@@ -1,199 +1,444 @@
 #include "graphics/texture.h"
-#include "math/vec.h"
+#include "graphics/pixels.h"
+#include "graphics/texture_cache.h"
+#include "utils/mapped_file.h"
 #include "utils/error.h"
 
+#include "image_file.h"
+
 #include <stdexcept>
 #include <algorithm>
+#include <cstring>
+#include <memory>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 SGUI_BEG
 
-void set_defaults()
-{
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	static vec4 border_col{0, 0, 0, 0};
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, value(border_col));
-}
+// parameters of a texture object that was just created
+static constexpr texture_desc gl_defaults{ .min_filter = GL_NEAREST_MIPMAP_LINEAR, .mag_filter = GL_LINEAR, .wrap_s = GL_REPEAT, .wrap_t = GL_REPEAT };
 
-void texture::load(const std::string &file_name, GLenum target_format)
+static GLenum sized_format(GLenum format)
 {
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char *data = stbi_load(file_name.c_str(), &width, &height, &nr_channels, 0);
-
-	if (!data)
+	switch (format)
 	{
-		detail::log_error(error("Couldn't open image " + file_name, error_code::file_open_failure));
-		return;
+	case GL_DEPTH_COMPONENT:
+		return GL_DEPTH_COMPONENT24;
+	case GL_RED:
+		return GL_R8;
+	case GL_RG:
+		return GL_RG8;
+	case GL_RGB:
+		return GL_RGB8;
+	case GL_RGBA:
+		return GL_RGBA8;
+	default:
+		return 0;
 	}
+}
 
-	GLint format;
-
-	switch (nr_channels)
+static GLenum pixel_format_of(int channel_count)
+{
+	switch (channel_count)
 	{
 	case 1:
-		format = GL_RED;
-		break;
+		return GL_RED;
 	case 2:
-		format = GL_RG;
-		break;
+		return GL_RG;
 	case 3:
-		format = GL_RGB;
-		break;
+		return GL_RGB;
 	case 4:
-		format = GL_RGBA;
-		break;
+		return GL_RGBA;
 	default:
-		detail::log_error(error("Unrecognized image format for image " + file_name + '.', error_code::unrecognized_file_format));
-		return;
+		return 0;
 	}
+}
 
-	switch (target_format)
+// bytes a texel of internal_format takes, rgb is padded to 4 bytes by most drivers
+static std::size_t texel_bytes(GLenum internal_format)
+{
+	switch (internal_format)
 	{
-	case GL_DEPTH_COMPONENT:
-	case GL_RED:
-		nr_channels = 1;
-		break;
-	case GL_RG:
-		nr_channels = 2;
-		break;
-	case GL_RGB:
-		nr_channels = 3;
-		break;
-	case GL_RGBA:
-		nr_channels = 4;
-		break;
+	case GL_R8:
+		return 1;
+	case GL_RG8:
+		return 2;
 	default:
+		return 4;
+	}
+}
+
+static bool is_mipmapped(GLenum filter)
+{
+	return filter != GL_NEAREST && filter != GL_LINEAR;
+}
+
+// levels of the mip chain of a width x height texture, down to 1x1
+static GLsizei full_chain(GLsizei width, GLsizei height)
+{
+	GLsizei res = 1;
+	for (GLsizei dim = std::max(width, height); dim > 1; dim /= 2)
+		++res;
+	return res;
+}
+
+// sets the sampling parameters of the bound texture that differ from prev
+static void apply_parameters(const texture_desc &desc, const texture_desc &prev)
+{
+	if (desc.min_filter != prev.min_filter)
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.min_filter);
+	if (desc.mag_filter != prev.mag_filter)
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.mag_filter);
+	if (desc.wrap_s != prev.wrap_s)
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, desc.wrap_s);
+	if (desc.wrap_t != prev.wrap_t)
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, desc.wrap_t);
+}
+
+// the flip of load(..., flip) goes through a band of rows of at most this size, so flipping an image never holds a second copy of it
+static constexpr std::size_t flip_band_bytes = std::size_t{ 1 } << 20;
+
+// the descriptions the older overloads of load stand for. Their default min filter doesn't sample mips, so no chain is allocated
+static constexpr texture_desc load_desc(GLenum target_format)
+{
+	return { .format = target_format, .mips = mip_policy::automatic };
+}
+
+bool texture::allocate(const texture_desc &desc, GLsizei width, GLsizei height)
+{
+	GLenum internal_format = sized_format(desc.format);
+
+	if (!internal_format)
+	{
 		detail::log_error(error("Unrecognized target format.", error_code::invalid_argument));
+		return false;
+	}
+
+	if (width <= 0 || height <= 0)
+	{
+		detail::log_error(error("Invalid texture size.", error_code::invalid_argument));
+		return false;
+	}
+
+	bool mipmapped = desc.mips == mip_policy::generate || desc.mips == mip_policy::provided || (desc.mips == mip_policy::automatic && is_mipmapped(desc.min_filter));
+
+	GLsizei chain = full_chain(width, height);
+	GLsizei count = mipmapped ? (desc.levels > 0 ? std::min(desc.levels, chain) : chain) : 1;
+
+	bool storage = GLEW_ARB_texture_storage && !desc.resizable;
+
+	// storage of the same size, format and mutability is reused as is
+	bool same = levels == count && this->width == width && this->height == height && sized_format(description.format) == internal_format && immutable == storage;
+
+	// parameters that aren't known to be set are all set again
+	texture_desc prev = levels ? description : gl_defaults;
+
+	detail::texture_lock lock;
+
+	if (!same)
+	{
+		// storage of an immutable texture can't be respecified, so it gets a new texture object. Mutable storage is respecified in place
+		if (immutable || !id)
+		{
+			glDeleteTextures(1, &id);
+			glGenTextures(1, &id);
+			prev = gl_defaults;
+		}
+
+		use();
+
+		if (storage)
+		{
+			glTexStorage2D(GL_TEXTURE_2D, count, internal_format, width, height);
+			immutable = true;
+		}
+		else
+		{
+			GLenum pixel_format = desc.format == GL_DEPTH_COMPONENT ? GL_DEPTH_COMPONENT : desc.format;
+			GLenum type = desc.format == GL_DEPTH_COMPONENT ? GL_UNSIGNED_INT : GL_UNSIGNED_BYTE;
+
+			for (GLsizei i = 0; i < count; ++i)
+				glTexImage2D(GL_TEXTURE_2D, i, internal_format, std::max(width >> i, 1), std::max(height >> i, 1), 0, pixel_format, type, nullptr);
+
+			// without it, a partial chain makes the texture incomplete
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, count - 1);
+			immutable = false;
+		}
+
+		std::size_t bytes = 0;
+		for (GLsizei i = 0; i < count; ++i)
+			bytes += static_cast<std::size_t>(std::max(width >> i, 1)) * std::max(height >> i, 1) * texel_bytes(internal_format);
+
+		residency_manager::get().track(resource_category::texture, detail::residency_key(this), bytes);
+	}
+	else
+		use();
+
+	apply_parameters(desc, prev);
+
+	this->width = width;
+	this->height = height;
+	nr_channels = desc.format == GL_RG ? 2 : desc.format == GL_RGB ? 3 : desc.format == GL_RGBA ? 4 : 1;
+	description = desc;
+	levels = count;
+
+	return true;
+}
+
+void texture::load(const texture_desc &desc, const void *data, GLsizei width, GLsizei height, int channel_count, texture_origin origin)
+{
+	GLenum pixel_format = pixel_format_of(channel_count);
+
+	if (!pixel_format)
+	{
+		detail::log_error(error("Invalid channel count.", error_code::invalid_argument));
 		return;
 	}
 
-	if (!id)
-		generate();
+	if (!allocate(desc, width, height))
+		return;
+
+	this->origin = origin;
 
 	detail::texture_lock lock;
+	detail::unpack_alignment_lock alock;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
 	use();
-	glTexImage2D(GL_TEXTURE_2D, 0, target_format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	set_defaults();
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, pixel_format, GL_UNSIGNED_BYTE, data);
 
-	stbi_image_free(data);
+	if (levels > 1 && desc.mips != mip_policy::provided)
+		glGenerateMipmap(GL_TEXTURE_2D);
 }
 
-void texture::load(GLenum target_format, const void *data, GLsizei width, GLsizei height, int channel_count, bool flip)
+void texture::load(const std::string &file_name, GLenum target_format)
 {
-	this->width = width;
-	this->height = height;
+	detail::mapped_file file(file_name);
 
-	GLenum pixel_format;
+	if (!file.is_open())
+	{
+		detail::log_error(error("Couldn't open image " + file_name, error_code::file_open_failure));
+		return;
+	}
 
-	switch (channel_count)
+	if (detail::texture_cache_view::is_cache(file.data(), file.size()))
 	{
-	case 1:
-		pixel_format = GL_RED;
-		break;
-	case 2:
-		pixel_format = GL_RG;
-		break;
-	case 3:
-		pixel_format = GL_RGB;
-		break;
-	case 4:
-		pixel_format = GL_RGBA;
-		break;
-	default:
-		detail::log_error(error("Invalid channel count.", error_code::invalid_argument));
+		detail::texture_cache_view cache;
+
+		if (cache.open(file.data(), file.size()))
+			load_cache(cache, target_format);
+		else
+			detail::log_error(error("Corrupt texture cache " + file_name, error_code::unrecognized_file_format));
 		return;
 	}
 
-	switch (target_format)
+	detail::decoded_image image;
+
+	if (!image.decode(file.data(), file.size()))
 	{
-	case GL_DEPTH_COMPONENT:
-	case GL_RED:
-		nr_channels = 1;
-		break;
-	case GL_RG:
-		nr_channels = 2;
-		break;
-	case GL_RGB:
-		nr_channels = 3;
-		break;
-	case GL_RGBA:
-		nr_channels = 4;
-		break;
-	default:
-		detail::log_error(error("Unrecognized target format.", error_code::invalid_argument));
+		detail::log_error(error("Couldn't open image " + file_name, error_code::file_open_failure));
 		return;
 	}
 
-	if (flip)
+	if (!pixel_format_of(image.channels()))
+		detail::log_error(error("Unrecognized image format for image " + file_name + '.', error_code::unrecognized_file_format));
+	else
 	{
-		int w = width * channel_count;
+		// decoders give rows top to bottom, which are uploaded as they are
+		load(load_desc(target_format), image.pixels(), image.width(), image.height(), image.channels(), texture_origin::top_left);
+	}
+}
 
-		const unsigned char *old_data = reinterpret_cast<const unsigned char *>(data);
-		unsigned char *new_data = new unsigned char[height * w];
+void texture::load_cache(const detail::texture_cache_view &cache, GLenum target_format)
+{
+	auto &header = cache.header();
 
-		for (int y = 0; y < height; ++y)
-		{
-			auto *in = old_data + (height - y - 1) * w;
-			std::copy(in, in + w, new_data + y * w);
-		}
+	// a single level is mipmapped like any other image
+	texture_desc desc = load_desc(target_format);
+	if (header.levels > 1)
+	{
+		desc.levels = static_cast<GLsizei>(header.levels);
+		desc.mips = mip_policy::provided;
+	}
+
+	if (!allocate(desc, static_cast<GLsizei>(header.width), static_cast<GLsizei>(header.height)))
+		return;
+
+	origin = texture_origin::bottom_left;
+
+	detail::texture_lock lock;
+	detail::unpack_alignment_lock alock;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	use();
+
+	// the driver reads the pixels straight out of the mapping
+	for (GLsizei i = 0; i < levels && i < static_cast<GLsizei>(header.levels); ++i)
+	{
+		auto &level = cache.level(static_cast<uint32_t>(i));
+		glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, header.format, GL_UNSIGNED_BYTE, cache.pixels(static_cast<uint32_t>(i)));
+	}
+
+	if (desc.mips != mip_policy::provided)
+		glGenerateMipmap(GL_TEXTURE_2D);
+}
 
-		data = new_data;
+void texture::load(GLenum target_format, const void *data, GLsizei width, GLsizei height, int channel_count, bool flip)
+{
+	GLenum pixel_format = pixel_format_of(channel_count);
+
+	// invalid channel counts are reported by the upload
+	if (!flip || !pixel_format)
+	{
+		load(target_format, data, width, height, channel_count, texture_origin::bottom_left);
+		return;
 	}
 
-	if (!id)
-		generate();
+	texture_desc desc = load_desc(target_format);
+	if (!allocate(desc, width, height))
+		return;
+
+	origin = texture_origin::bottom_left;
+
+	std::size_t row = static_cast<std::size_t>(width) * channel_count;
+	GLsizei band = static_cast<GLsizei>(std::clamp<std::size_t>(flip_band_bytes / row, 1, static_cast<std::size_t>(height)));
+	auto scratch = std::make_unique_for_overwrite<unsigned char[]>(row * band);
 
 	detail::texture_lock lock;
+	detail::unpack_alignment_lock alock;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
 	use();
-	glTexImage2D(GL_TEXTURE_2D, 0, target_format, width, height, 0, pixel_format, GL_UNSIGNED_BYTE, data);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	set_defaults();
 
-	if (flip)
-		delete[] reinterpret_cast<const unsigned char *>(data);
+	// y counts the texture's rows from the bottom, which are the last rows of data
+	auto *src = static_cast<const unsigned char *>(data);
+	for (GLsizei y = 0; y < height; y += band)
+	{
+		GLsizei count = std::min(band, height - y);
+
+		detail::copy_rows_flipped(scratch.get(), src + static_cast<std::size_t>(height - y - count) * row, row, static_cast<std::size_t>(count));
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, count, pixel_format, GL_UNSIGNED_BYTE, scratch.get());
+	}
+
+	if (levels > 1 && desc.mips != mip_policy::provided)
+		glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+void texture::load(GLenum target_format, const void *data, GLsizei width, GLsizei height, int channel_count, texture_origin origin)
+{
+	load(load_desc(target_format), data, width, height, channel_count, origin);
 }
 
 void texture::reserve(GLenum target_format, GLsizei width, GLsizei height)
 {
-	this->width = width;
-	this->height = height;
+	// render targets are resized through reserve, which has to keep the texture attached to their framebuffers
+	if (allocate({ .format = target_format, .resizable = true }, width, height))
+		origin = texture_origin::bottom_left;
+}
+
+void texture::sub_image(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, const void *data)
+{
+	detail::texture_lock lock;
+
+	use();
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, GL_UNSIGNED_BYTE, data);
+}
 
-	switch (target_format)
+static int bytes_per_pixel(GLenum format)
+{
+	switch (format)
 	{
-	case GL_DEPTH_COMPONENT:
 	case GL_RED:
-		nr_channels = 1;
-		break;
+		return 1;
 	case GL_RG:
-		nr_channels = 2;
-		break;
+		return 2;
 	case GL_RGB:
-		nr_channels = 3;
-		break;
+	case GL_BGR:
+		return 3;
 	case GL_RGBA:
-		nr_channels = 4;
-		break;
+	case GL_BGRA:
+		return 4;
 	default:
-		detail::log_error(error("Unrecognized target format.", error_code::invalid_argument));
-		return;
+		return 0;
 	}
+}
 
-	if (!id)
-		generate();
+void texture::set_stream_buffers(int count)
+{
+	stream.count = std::clamp(count, 2, detail::pixel_stream::max_buffers);
+	stream.next %= stream.count;
+}
+
+void *texture::map_region(GLsizei width, GLsizei height, GLenum format)
+{
+	int pixel = bytes_per_pixel(format);
+	if (!pixel)
+	{
+		detail::log_error(error("Unrecognized pixel format.", error_code::invalid_argument));
+		return nullptr;
+	}
 
+	auto size = static_cast<GLsizeiptr>(width) * height * pixel;
+	int i = stream.next;
+
+	if (!stream.buffers[i])
+		glGenBuffers(1, &stream.buffers[i]);
+
+	detail::pbo_lock lock;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream.buffers[i]);
+
+	// orphaning gives the buffer new storage if the gpu still reads the old one, instead of waiting for it
+	if (stream.sizes[i] < size)
+	{
+		stream.sizes[i] = size;
+		residency_manager::get().track(resource_category::buffer, stream.buffers[i], static_cast<std::size_t>(size));
+	}
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, stream.sizes[i], nullptr, GL_STREAM_DRAW);
+
+	return glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+}
+
+void texture::commit_region(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format)
+{
+	GLuint pixel_buffer = stream.buffers[stream.next];
+
+	{
+		detail::pbo_lock lock;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+
+	stream.next = (stream.next + 1) % stream.count;
+
+	update_region_from_buffer(x, y, width, height, format, pixel_buffer, 0);
+}
+
+void texture::update_region(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, const void *data)
+{
+	auto *dst = map_region(width, height, format);
+	if (!dst)
+		return;
+
+	std::memcpy(dst, data, static_cast<std::size_t>(width) * height * bytes_per_pixel(format));
+	commit_region(x, y, width, height, format);
+}
+
+void texture::update_region_from_buffer(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLuint pixel_buffer, GLintptr offset)
+{
 	detail::texture_lock lock;
+	detail::pbo_lock plock;
+	detail::unpack_alignment_lock alock;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
 
 	use();
-	glTexImage2D(GL_TEXTURE_2D, 0, target_format, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-	set_defaults();
+	// with a pixel unpack buffer bound, the pointer is an offset into it
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, GL_UNSIGNED_BYTE, reinterpret_cast<const void *>(offset));
 }
 
 SGUI_END
\ No newline at end of file
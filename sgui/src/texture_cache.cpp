@@ -0,0 +1,159 @@
+#include "graphics/texture_cache.h"
+#include "graphics/resample.h"
+#include "utils/thread_pool.h"
+#include "utils/error.h"
+
+#include "image_file.h"
+
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+SGUI_BEG
+
+static int channels_of(GLenum format)
+{
+	switch (format)
+	{
+	case GL_RED:
+		return 1;
+	case GL_RG:
+		return 2;
+	case GL_RGB:
+		return 3;
+	case GL_RGBA:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static constexpr uint64_t align_offset(uint64_t offset)
+{
+	return (offset + 15) & ~uint64_t{ 15 };
+}
+
+bool convert_texture(const std::string &image_file, const std::string &cache_file, GLenum target_format, bool mipmaps)
+{
+	GLenum format = target_format == GL_DEPTH_COMPONENT ? GL_RED : target_format;
+	int channels = channels_of(format);
+
+	if (!channels)
+	{
+		detail::log_error(error("Unrecognized target format.", error_code::invalid_argument));
+		return false;
+	}
+
+	detail::decoded_image image;
+
+	if (!image.load(image_file, channels))
+	{
+		detail::log_error(error("Couldn't open image " + image_file, error_code::file_open_failure));
+		return false;
+	}
+
+	unsigned char *data = image.pixels();
+	int width = image.width();
+	int height = image.height();
+
+	std::vector<texture_cache_level> levels{ { 0, static_cast<uint32_t>(width), static_cast<uint32_t>(height) } };
+	std::vector<mip_level> mips;
+
+	if (mipmaps)
+	{
+		// conversions run offline, every core is spent on them
+		thread_pool pool;
+		mips = build_mip_chain(data, width, height, channels, resample_filter::box, &pool);
+
+		for (auto &mip : mips)
+			levels.push_back({ 0, static_cast<uint32_t>(mip.width), static_cast<uint32_t>(mip.height) });
+	}
+
+	texture_cache_header header{};
+	std::memcpy(header.magic, texture_cache_header::magic_bytes, sizeof(header.magic));
+	header.version = texture_cache_header::current_version;
+	header.width = static_cast<uint32_t>(width);
+	header.height = static_cast<uint32_t>(height);
+	header.format = format;
+	header.levels = static_cast<uint32_t>(levels.size());
+
+	uint64_t offset = sizeof(header) + levels.size() * sizeof(texture_cache_level);
+	for (auto &level : levels)
+	{
+		level.offset = offset = align_offset(offset);
+		offset += static_cast<uint64_t>(level.width) * level.height * channels;
+	}
+
+	std::ofstream out(cache_file, std::ios::binary | std::ios::trunc);
+
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char *>(levels.data()), levels.size() * sizeof(texture_cache_level));
+
+	for (std::size_t i = 0; i < levels.size(); ++i)
+	{
+		static constexpr char padding[16] = {};
+		out.write(padding, static_cast<std::streamsize>(levels[i].offset - static_cast<uint64_t>(out.tellp())));
+
+		// the image and its mips are top to bottom, levels are stored bottom to top like every other texture
+		auto *pixels = i ? mips[i - 1].pixels.data() : data;
+		auto row = static_cast<std::streamsize>(levels[i].width) * channels;
+		for (uint32_t y = levels[i].height; y--;)
+			out.write(reinterpret_cast<const char *>(pixels) + y * row, row);
+	}
+
+	if (!out)
+	{
+		detail::log_error(error("Couldn't write texture cache " + cache_file, error_code::file_open_failure));
+		return false;
+	}
+
+	return true;
+}
+
+DETAIL_BEG
+
+bool texture_cache_view::is_cache(const unsigned char *data, std::size_t size)
+{
+	return size >= sizeof(texture_cache_header) && !std::memcmp(data, texture_cache_header::magic_bytes, sizeof(texture_cache_header::magic_bytes));
+}
+
+bool texture_cache_view::open(const unsigned char *data, std::size_t size)
+{
+	if (!is_cache(data, size))
+		return false;
+
+	auto *header = reinterpret_cast<const texture_cache_header *>(data);
+	int channels = channels_of(header->format);
+
+	if (header->version != texture_cache_header::current_version || !channels || !header->levels || header->levels > 32)
+		return false;
+
+	uint64_t table_end = sizeof(texture_cache_header) + static_cast<uint64_t>(header->levels) * sizeof(texture_cache_level);
+	if (table_end > size)
+		return false;
+
+	auto *levels = reinterpret_cast<const texture_cache_level *>(data + sizeof(texture_cache_header));
+
+	if (levels[0].width != header->width || levels[0].height != header->height)
+		return false;
+
+	for (uint32_t i = 0; i < header->levels; ++i)
+	{
+		auto &level = levels[i];
+		uint64_t bytes = static_cast<uint64_t>(level.width) * level.height * channels;
+
+		if (!level.width || !level.height || level.offset < table_end || level.offset > size || bytes > size - level.offset)
+			return false;
+	}
+
+	M_header = header;
+	M_levels = levels;
+	M_data = data;
+
+	return true;
+}
+
+DETAIL_END
+
+SGUI_END
@@ -0,0 +1,122 @@
+#include "graphics/texture_loader.h"
+#include "utils/error.h"
+
+#include "image_file.h"
+
+SGUI_BEG
+
+struct texture_loader::job
+{
+	std::weak_ptr<texture> text;
+	std::string file_name;
+	GLenum target_format;
+	callback on_done;
+	std::promise<bool> done;
+
+	detail::decoded_image image;
+};
+
+texture_loader::texture_loader(unsigned int threads) : M_pending{}, M_frame_budget{ std::chrono::milliseconds(2) }, M_threads{ threads } {}
+
+texture_loader::~texture_loader()
+{
+	// stops the workers first, jobs they didn't get to are dropped with the pool's queue
+	M_pool.reset();
+
+	for (auto &cur : M_ready)
+		cur->done.set_value(false);
+}
+
+texture_loader &texture_loader::get()
+{
+	static texture_loader res;
+	return res;
+}
+
+texture_loader::result texture_loader::load(const std::string &file_name, GLenum target_format, callback on_done)
+{
+	static const unsigned char transparent[4]{};
+
+	auto text = std::make_shared<texture>(target_format, transparent, 1, 1, 4, false);
+
+	auto cur = std::make_shared<job>();
+	cur->text = text;
+	cur->file_name = file_name;
+	cur->target_format = target_format;
+	cur->on_done = std::move(on_done);
+
+	result res{ std::move(text), cur->done.get_future().share() };
+
+	if (!M_pool)
+		M_pool = std::make_unique<thread_pool>(M_threads);
+
+	M_pending.fetch_add(1, std::memory_order_relaxed);
+	M_pool->submit([this, cur]() { decode(cur); });
+
+	return res;
+}
+
+void texture_loader::decode(const std::shared_ptr<job> &cur)
+{
+	// rows stay top to bottom, the texture is uploaded top left like texture::load does
+	cur->image.load(cur->file_name);
+
+	{
+		std::lock_guard lock(M_mutex);
+		M_ready.push_back(cur);
+	}
+
+	if (M_ready_callback)
+		M_ready_callback();
+}
+
+std::size_t texture_loader::upload(std::chrono::microseconds budget)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::size_t count = 0;
+
+	for (;;)
+	{
+		std::shared_ptr<job> cur;
+
+		{
+			std::lock_guard lock(M_mutex);
+			if (M_ready.empty())
+				break;
+
+			if (count && std::chrono::steady_clock::now() - start >= budget)
+			{
+				// the rest waits for the next frame, which shouldn't wait for input first
+				if (M_ready_callback)
+					M_ready_callback();
+				break;
+			}
+
+			cur = std::move(M_ready.front());
+			M_ready.pop_front();
+		}
+
+		M_pending.fetch_sub(1, std::memory_order_relaxed);
+
+		auto text = cur->text.lock();
+		auto &image = cur->image;
+		bool ok = image.pixels() != nullptr;
+
+		if (!ok)
+			detail::log_error(error("Couldn't open image " + cur->file_name, error_code::file_open_failure));
+		else if (text)
+		{
+			text->load(cur->target_format, image.pixels(), image.width(), image.height(), image.channels(), texture_origin::top_left);
+			++count;
+		}
+
+		if (text && cur->on_done)
+			cur->on_done(*text, ok);
+
+		cur->done.set_value(ok);
+	}
+
+	return count;
+}
+
+SGUI_END
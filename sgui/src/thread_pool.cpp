@@ -0,0 +1,113 @@
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+SGUI_BEG
+
+thread_pool::thread_pool(unsigned int threads) : M_stop{}
+{
+	if (!threads)
+		threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+	M_threads.reserve(threads);
+	for (unsigned int i = 0; i < threads; ++i)
+		M_threads.emplace_back([this]() { work(); });
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard lock(M_mutex);
+		M_stop = true;
+		M_tasks.clear();
+	}
+
+	M_wake.notify_all();
+
+	for (auto &thread : M_threads)
+		thread.join();
+}
+
+void thread_pool::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard lock(M_mutex);
+		M_tasks.push_back(std::move(task));
+	}
+
+	M_wake.notify_one();
+}
+
+void thread_pool::parallel_for(std::size_t begin, std::size_t end, const std::function<void(std::size_t, std::size_t)> &body, std::size_t grain)
+{
+	if (begin >= end)
+		return;
+
+	std::size_t count = end - begin;
+	grain = std::max<std::size_t>(grain, 1);
+
+	// a few ranges per thread, so the threads that finish early take over from the slower ones
+	std::size_t ranges = std::min<std::size_t>((count + grain - 1) / grain, (std::size_t{ size() } + 1) * 4);
+	if (ranges <= 1 || M_threads.empty())
+	{
+		body(begin, end);
+		return;
+	}
+
+	struct progress
+	{
+		std::atomic<std::size_t> next{};
+		std::size_t done{};
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	auto state = std::make_shared<progress>();
+
+	// tasks that start once every range is taken return without touching body, so they can outlive this call
+	auto run = [state, &body, begin, count, ranges]()
+	{
+		for (std::size_t i; (i = state->next.fetch_add(1, std::memory_order_relaxed)) < ranges;)
+		{
+			body(begin + count * i / ranges, begin + count * (i + 1) / ranges);
+
+			std::lock_guard lock(state->mutex);
+			if (++state->done == ranges)
+				state->finished.notify_all();
+		}
+	};
+
+	std::size_t helpers = std::min<std::size_t>(M_threads.size(), ranges - 1);
+	for (std::size_t i = 0; i < helpers; ++i)
+		submit(run);
+
+	run();
+
+	std::unique_lock lock(state->mutex);
+	state->finished.wait(lock, [&]() { return state->done == ranges; });
+}
+
+void thread_pool::work()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock lock(M_mutex);
+			M_wake.wait(lock, [this]() { return M_stop || !M_tasks.empty(); });
+
+			if (M_stop)
+				return;
+
+			task = std::move(M_tasks.front());
+			M_tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+SGUI_END
@@ -0,0 +1,239 @@
+#include "graphics/tile_pyramid.h"
+#include "utils/error.h"
+
+#include "image_file.h"
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+
+SGUI_BEG
+
+static constexpr uint64_t align_offset(uint64_t offset)
+{
+	return (offset + 15) & ~uint64_t{ 15 };
+}
+
+static constexpr bool is_valid_tile_size(uint32_t tile_size)
+{
+	return tile_size >= 16 && tile_size <= 1024 && !(tile_size & (tile_size - 1));
+}
+
+bool tile_source::set_geometry(uint32_t width, uint32_t height, uint32_t tile_size)
+{
+	if (!width || !height || !tile_size)
+		return false;
+
+	M_width = width;
+	M_height = height;
+	M_tile_size = tile_size;
+	M_levels = 1;
+
+	while (level_width(M_levels - 1) > tile_size || level_height(M_levels - 1) > tile_size)
+		++M_levels;
+
+	return true;
+}
+
+// next level of the pyramid, each pixel averages the 2x2 pixels it covers. Odd sizes round up, repeating the last row or column
+static std::vector<unsigned char> halve(const unsigned char *src, uint32_t width, uint32_t height)
+{
+	uint32_t res_width = (width + 1) / 2;
+	uint32_t res_height = (height + 1) / 2;
+
+	std::vector<unsigned char> res(static_cast<std::size_t>(res_width) * res_height * 4);
+
+	for (uint32_t y = 0; y < res_height; ++y)
+	{
+		auto *row0 = src + static_cast<std::size_t>(2 * y) * width * 4;
+		auto *row1 = src + static_cast<std::size_t>(std::min(2 * y + 1, height - 1)) * width * 4;
+		auto *out = res.data() + static_cast<std::size_t>(y) * res_width * 4;
+
+		for (uint32_t x = 0; x < res_width; ++x)
+		{
+			uint32_t x0 = 2 * x * 4;
+			uint32_t x1 = std::min(2 * x + 1, width - 1) * 4;
+
+			for (int c = 0; c < 4; ++c)
+				*out++ = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+		}
+	}
+
+	return res;
+}
+
+// copies a tile and its border out of a level, repeating the level's edges past them
+static void cut_tile(const unsigned char *level, uint32_t width, uint32_t height, uint32_t tile_size, uint32_t column, uint32_t row, unsigned char *out)
+{
+	int64_t stride = tile_size + 2;
+	int64_t left = int64_t{ column } * tile_size - 1;
+	int64_t top = int64_t{ row } * tile_size - 1;
+
+	for (int64_t y = 0; y < stride; ++y)
+	{
+		auto src_y = std::clamp<int64_t>(top + y, 0, height - 1);
+		auto *src = level + static_cast<std::size_t>(src_y) * width * 4;
+
+		for (int64_t x = 0; x < stride; ++x)
+		{
+			auto src_x = std::clamp<int64_t>(left + x, 0, width - 1);
+			std::memcpy(out, src + src_x * 4, 4);
+			out += 4;
+		}
+	}
+}
+
+namespace
+{
+	// only used for its geometry while converting
+	class pyramid_layout : public tile_source
+	{
+	public:
+		bool init(uint32_t width, uint32_t height, uint32_t tile_size) { return set_geometry(width, height, tile_size); }
+		bool read_tile(uint32_t, uint32_t, uint32_t, unsigned char *) const override { return false; }
+	};
+}
+
+bool convert_tile_pyramid(const std::string &image_file, const std::string &pyramid_file, uint32_t tile_size)
+{
+	if (!is_valid_tile_size(tile_size))
+	{
+		detail::log_error(error("Tile size isn't a power of two from 16 to 1024.", error_code::invalid_argument));
+		return false;
+	}
+
+	detail::decoded_image image;
+	pyramid_layout layout;
+
+	if (!image.load(image_file, 4) || !layout.init(static_cast<uint32_t>(image.width()), static_cast<uint32_t>(image.height()), tile_size))
+	{
+		detail::log_error(error("Couldn't open image " + image_file, error_code::file_open_failure));
+		return false;
+	}
+
+	std::size_t tile_bytes = static_cast<std::size_t>(layout.tile_stride()) * layout.tile_stride() * 4;
+
+	tile_pyramid_header header{};
+	std::memcpy(header.magic, tile_pyramid_header::magic_bytes, sizeof(header.magic));
+	header.version = tile_pyramid_header::current_version;
+	header.width = layout.width();
+	header.height = layout.height();
+	header.tile_size = tile_size;
+	header.levels = layout.levels();
+
+	std::vector<tile_pyramid_level> levels(layout.levels());
+
+	uint64_t offset = sizeof(header) + levels.size() * sizeof(tile_pyramid_level);
+	for (uint32_t i = 0; i < layout.levels(); ++i)
+	{
+		levels[i].columns = layout.columns(i);
+		levels[i].rows = layout.rows(i);
+		levels[i].offset = offset = align_offset(offset);
+		offset += uint64_t{ levels[i].columns } * levels[i].rows * tile_bytes;
+	}
+
+	std::ofstream out(pyramid_file, std::ios::binary | std::ios::trunc);
+
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char *>(levels.data()), levels.size() * sizeof(tile_pyramid_level));
+
+	std::vector<unsigned char> tile(tile_bytes);
+	std::vector<unsigned char> next;
+	const unsigned char *cur = image.pixels();
+
+	for (uint32_t i = 0; i < layout.levels() && out; ++i)
+	{
+		static constexpr char padding[16] = {};
+		out.write(padding, static_cast<std::streamsize>(levels[i].offset - static_cast<uint64_t>(out.tellp())));
+
+		for (uint32_t row = 0; row < levels[i].rows; ++row)
+		{
+			for (uint32_t column = 0; column < levels[i].columns; ++column)
+			{
+				cut_tile(cur, layout.level_width(i), layout.level_height(i), tile_size, column, row, tile.data());
+				out.write(reinterpret_cast<const char *>(tile.data()), static_cast<std::streamsize>(tile_bytes));
+			}
+		}
+
+		if (i + 1 < layout.levels())
+		{
+			auto res = halve(cur, layout.level_width(i), layout.level_height(i));
+
+			// only the level being cut is kept, the full image is the largest allocation of the conversion
+			image.reset();
+
+			next = std::move(res);
+			cur = next.data();
+		}
+	}
+
+	if (!out)
+	{
+		detail::log_error(error("Couldn't write tile pyramid " + pyramid_file, error_code::file_open_failure));
+		return false;
+	}
+
+	return true;
+}
+
+bool tile_pyramid::open(const std::string &file_name)
+{
+	M_levels = nullptr;
+
+	if (!M_file.open(file_name, detail::mapped_file::access_pattern::random))
+	{
+		detail::log_error(error("Couldn't open tile pyramid " + file_name, error_code::file_open_failure));
+		return false;
+	}
+
+	auto *data = M_file.data();
+	auto size = M_file.size();
+
+	auto fail = [&]()
+	{
+		M_file.close();
+		detail::log_error(error(file_name + " isn't a valid tile pyramid.", error_code::unrecognized_file_format));
+		return false;
+	};
+
+	if (size < sizeof(tile_pyramid_header) || std::memcmp(data, tile_pyramid_header::magic_bytes, sizeof(tile_pyramid_header::magic_bytes)))
+		return fail();
+
+	auto *header = reinterpret_cast<const tile_pyramid_header *>(data);
+
+	if (header->version != tile_pyramid_header::current_version || !is_valid_tile_size(header->tile_size) || !set_geometry(header->width, header->height, header->tile_size))
+		return fail();
+
+	uint64_t table_end = sizeof(tile_pyramid_header) + uint64_t{ header->levels } * sizeof(tile_pyramid_level);
+	if (header->levels != levels() || table_end > size)
+		return fail();
+
+	auto *table = reinterpret_cast<const tile_pyramid_level *>(data + sizeof(tile_pyramid_header));
+	uint64_t tile_bytes = uint64_t{ tile_stride() } * tile_stride() * 4;
+
+	for (uint32_t i = 0; i < levels(); ++i)
+	{
+		auto &level = table[i];
+		uint64_t bytes = uint64_t{ level.columns } * level.rows * tile_bytes;
+
+		if (level.columns != columns(i) || level.rows != rows(i) || level.offset < table_end || level.offset > size || bytes > size - level.offset)
+			return fail();
+	}
+
+	M_levels = table;
+	return true;
+}
+
+bool tile_pyramid::read_tile(uint32_t level, uint32_t column, uint32_t row, unsigned char *rgba) const
+{
+	if (!M_levels || level >= levels() || column >= M_levels[level].columns || row >= M_levels[level].rows)
+		return false;
+
+	std::size_t tile_bytes = static_cast<std::size_t>(tile_stride()) * tile_stride() * 4;
+	uint64_t offset = M_levels[level].offset + (uint64_t{ row } * M_levels[level].columns + column) * tile_bytes;
+
+	std::memcpy(rgba, M_file.data() + offset, tile_bytes);
+	return true;
+}
+
+SGUI_END
@@ -0,0 +1,523 @@
+#include "gui/tiled_image.h"
+#include "gui/window.h"
+#include "graphics/shaders.h"
+#include "utils/thread_pool.h"
+#include "utils/error.h"
+
+#include "help.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <iterator>
+#include <cmath>
+#include <cstring>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+SGUI_BEG
+
+struct tiled_image::request
+{
+	uint64_t key;
+	uint32_t level;
+	uint32_t column;
+	uint32_t row;
+	// last frame the tile was visible in, only used by the OpenGL thread
+	uint64_t wanted;
+	// set once the tile falls out of view, workers skip cancelled requests they haven't started
+	std::atomic<bool> cancelled;
+	std::vector<unsigned char> pixels;
+};
+
+struct tiled_image::stream
+{
+	std::shared_ptr<const tile_source> source;
+	std::mutex mutex;
+	std::deque<std::shared_ptr<request>> ready;
+	std::function<void()> ready_callback;
+};
+
+// shared by every tiled image. Queued tiles are dropped on exit, and the streams they write to are kept alive by the tasks
+static thread_pool &tile_workers()
+{
+	static thread_pool res;
+	return res;
+}
+
+static shader &tiled_image_shader()
+{
+	static std::string vertex_source =
+		"#version 410 core\n"
+		"uniform mat4 SGUI_Ortho;"
+		"out vec2 SGUI_VertImagePos;"
+		"layout (location = " STR(pos_loc) ") in vec2 SGUI_Pos;"
+		"layout (location = " STR(textPos_loc) ") in vec2 SGUI_ImagePos;"
+		"void main() {"
+		"	gl_Position = SGUI_Ortho * vec4(SGUI_Pos, 0.0, 1.0);"
+		"	SGUI_VertImagePos = SGUI_ImagePos;"
+		"}";
+	// the page of the first level's tile under the pixel holds the slot and level of the finest resident tile covering it.
+	// Positions are in image pixels, and tiles carry a border pixel, so linear filtering never reads a neighbouring slot
+	static std::string fragment_source =
+		"#version 410 core\n"
+		"uniform sampler2D SGUI_Cache;"
+		"uniform sampler2D SGUI_Pages;"
+		"uniform vec2 SGUI_ImageSize;"
+		"uniform float SGUI_TileSize;"
+		"uniform float SGUI_TileStride;"
+		"uniform float SGUI_CacheSize;"
+		"in vec2 SGUI_VertImagePos;"
+		"out vec4 SGUI_OutColor;"
+		"void main() {"
+		"	if (any(lessThan(SGUI_VertImagePos, vec2(0.0))) || any(greaterThanEqual(SGUI_VertImagePos, SGUI_ImageSize)))"
+		"		discard;"
+		"	vec4 page = round(texelFetch(SGUI_Pages, ivec2(SGUI_VertImagePos / SGUI_TileSize), 0) * 255.0);"
+		"	if (page.a == 0.0)"
+		"		discard;"
+		"	vec2 pos = SGUI_VertImagePos / exp2(page.b);"
+		"	vec2 local = pos - floor(pos / SGUI_TileSize) * SGUI_TileSize;"
+		"	SGUI_OutColor = texture(SGUI_Cache, (page.rg * SGUI_TileStride + 1.0 + local) / SGUI_CacheSize);"
+		"}";
+	static shader res = []()
+	{
+		shader res;
+		res.load_from_memory(vertex_source, fragment_source);
+		return res;
+	}();
+	return res;
+}
+
+tiled_image::tiled_image(std::shared_ptr<const tile_source> source, vec2 min, vec2 dims) :
+	rectangle(min, dims), M_center{}, M_zoom{ 1 }, M_cache_size{ 4096 }, M_upload_budget{ 8 }, M_stream{ std::make_shared<stream>() },
+	M_pages_dirty{}, M_pages_level{}, M_slots_per_row{}, M_frame{}, M_root{}
+{
+	M_stream->source = std::move(source);
+	M_stream->ready_callback = glfwPostEmptyEvent;
+	M_root = make_key(this->source().levels() - 1, 0, 0);
+
+	fit();
+}
+
+tiled_image::~tiled_image()
+{
+	for (auto &cur : M_pending)
+		cur.second->cancelled.store(true, std::memory_order_relaxed);
+}
+
+vec2 tiled_image::min() const
+{
+	return rectangle::min();
+}
+
+vec2 tiled_image::size() const
+{
+	return rectangle::size();
+}
+
+bool tiled_image::in_bounds(vec2 loc, vec2 absolute_min) const
+{
+	return rectangle::in_bounds(loc, absolute_min);
+}
+
+const tile_source &tiled_image::source() const
+{
+	return *M_stream->source;
+}
+
+void tiled_image::set_view(vec2 center, float zoom)
+{
+	M_center = center;
+	M_zoom = std::max(zoom, 1e-6f);
+}
+
+void tiled_image::pan(vec2 offset)
+{
+	// screen y goes up, image y goes down
+	M_center.x -= offset.x / M_zoom;
+	M_center.y += offset.y / M_zoom;
+}
+
+void tiled_image::zoom_at(float factor, vec2 point)
+{
+	vec2 from_center = point - M_dims / 2;
+	from_center.y = -from_center.y;
+
+	vec2 under = M_center + from_center / M_zoom;
+
+	M_zoom = std::max(M_zoom * factor, 1e-6f);
+	M_center = under - from_center / M_zoom;
+}
+
+void tiled_image::fit()
+{
+	auto &src = source();
+
+	M_center = { src.width() / 2.f, src.height() / 2.f };
+	M_zoom = std::max(std::min(M_dims.x / src.width(), M_dims.y / src.height()), 1e-6f);
+}
+
+void tiled_image::set_ready_callback(std::function<void()> ready)
+{
+	std::lock_guard lock(M_stream->mutex);
+	M_stream->ready_callback = std::move(ready);
+}
+
+void tiled_image::request_tile(uint64_t key) const
+{
+	auto cur = std::make_shared<request>();
+	cur->key = key;
+	cur->level = static_cast<uint32_t>(key >> 48);
+	cur->row = static_cast<uint32_t>(key >> 24) & 0xffffff;
+	cur->column = static_cast<uint32_t>(key) & 0xffffff;
+	cur->wanted = M_frame;
+	cur->cancelled.store(false, std::memory_order_relaxed);
+
+	M_pending.emplace(key, cur);
+
+	tile_workers().submit([str = M_stream, cur]()
+	{
+		if (cur->cancelled.load(std::memory_order_relaxed))
+			return;
+
+		auto &src = *str->source;
+		cur->pixels.resize(static_cast<std::size_t>(src.tile_stride()) * src.tile_stride() * 4);
+
+		// tiles that can't be read are drawn transparent, rather than requested again every frame
+		if (!src.read_tile(cur->level, cur->column, cur->row, cur->pixels.data()))
+			std::fill(cur->pixels.begin(), cur->pixels.end(), 0);
+
+		std::function<void()> ready;
+
+		{
+			std::lock_guard lock(str->mutex);
+			str->ready.push_back(cur);
+			ready = str->ready_callback;
+		}
+
+		if (ready)
+			ready();
+	});
+}
+
+uint32_t tiled_image::find_slot() const
+{
+	uint32_t res = no_slot;
+
+	for (uint32_t i = 0; i < M_slots.size(); ++i)
+	{
+		auto &cur = M_slots[i];
+
+		if (cur.key == no_tile)
+			return i;
+
+		if (cur.key == M_root || cur.last_used >= M_frame)
+			continue;
+
+		if (res == no_slot || cur.last_used < M_slots[res].last_used)
+			res = i;
+	}
+
+	return res;
+}
+
+bool tiled_image::upload_tile(const request &ready) const
+{
+	uint32_t index = find_slot();
+	if (index == no_slot)
+		return false;
+
+	auto &cur = M_slots[index];
+	if (cur.key != no_tile)
+		M_resident.erase(cur.key);
+
+	cur.key = ready.key;
+	cur.last_used = M_frame;
+	M_resident[ready.key] = index;
+
+	auto stride = static_cast<GLsizei>(source().tile_stride());
+	M_cache.sub_image(static_cast<GLint>(index % M_slots_per_row) * stride, static_cast<GLint>(index / M_slots_per_row) * stride, stride, stride, GL_RGBA, ready.pixels.data());
+
+	M_pages_dirty = true;
+	return true;
+}
+
+void tiled_image::rebuild_pages(uint32_t finest_level) const
+{
+	auto &src = source();
+	uint32_t columns = src.columns(0);
+	uint32_t rows = src.rows(0);
+
+	std::vector<std::pair<uint64_t, uint32_t>> tiles;
+	for (auto &cur : M_resident)
+		if (cur.first >> 48 >= finest_level)
+			tiles.push_back(cur);
+
+	// coarsest first, so finer tiles overwrite the pages they cover
+	std::sort(tiles.begin(), tiles.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+
+	std::fill(M_page_data.begin(), M_page_data.end(), 0);
+
+	for (auto [key, index] : tiles)
+	{
+		auto level = static_cast<uint32_t>(key >> 48);
+		auto row = static_cast<uint32_t>(key >> 24) & 0xffffff;
+		auto column = static_cast<uint32_t>(key) & 0xffffff;
+
+		unsigned char page[4]{ static_cast<unsigned char>(index % M_slots_per_row), static_cast<unsigned char>(index / M_slots_per_row), static_cast<unsigned char>(level), 255 };
+
+		uint32_t x_end = static_cast<uint32_t>(std::min<uint64_t>(uint64_t{ column + 1 } << level, columns));
+		uint32_t y_end = static_cast<uint32_t>(std::min<uint64_t>(uint64_t{ row + 1 } << level, rows));
+
+		for (uint32_t y = row << level; y < y_end; ++y)
+			for (uint32_t x = column << level; x < x_end; ++x)
+				std::memcpy(&M_page_data[(static_cast<std::size_t>(y) * columns + x) * 4], page, 4);
+	}
+
+	M_pages.sub_image(0, 0, static_cast<GLsizei>(columns), static_cast<GLsizei>(rows), GL_RGBA, M_page_data.data());
+
+	M_pages_level = finest_level;
+	M_pages_dirty = false;
+}
+
+void tiled_image::update() const
+{
+	auto &src = source();
+	++M_frame;
+
+	// the coarsest level whose pixels are at most 1 screen pixel (between 0.5 and 1), so it's never magnified
+	uint32_t level = 0;
+	if (M_zoom < 1)
+		level = std::min(static_cast<uint32_t>(std::floor(std::log2(1 / M_zoom))), src.levels() - 1);
+
+	// visible part of the image, in image pixels
+	vec2 half = M_dims / (2 * M_zoom);
+	double x0 = std::max(M_center.x - half.x, 0.f);
+	double y0 = std::max(M_center.y - half.y, 0.f);
+	double x1 = std::min<double>(M_center.x + half.x, src.width());
+	double y1 = std::min<double>(M_center.y + half.y, src.height());
+
+	if (auto root = M_resident.find(M_root); root != M_resident.end())
+		M_slots[root->second].last_used = M_frame;
+	else if (!M_pending.contains(M_root))
+		request_tile(M_root);
+
+	std::vector<std::pair<double, uint64_t>> missing;
+
+	if (x0 < x1 && y0 < y1)
+	{
+		double scale;
+		uint32_t column_begin, row_begin, column_end, row_end;
+
+		// a cache too small for the visible tiles of the level draws a coarser one, rather than evicting tiles it's drawing
+		for (;; ++level)
+		{
+			scale = std::ldexp(static_cast<double>(src.tile_size()), static_cast<int>(level));
+
+			column_begin = static_cast<uint32_t>(x0 / scale);
+			row_begin = static_cast<uint32_t>(y0 / scale);
+			column_end = std::min(static_cast<uint32_t>(std::ceil(x1 / scale)), src.columns(level));
+			row_end = std::min(static_cast<uint32_t>(std::ceil(y1 / scale)), src.rows(level));
+
+			// the root keeps a slot to itself
+			if (level + 1 >= src.levels() || uint64_t{ column_end - column_begin } * (row_end - row_begin) < M_slots.size())
+				break;
+		}
+
+		for (uint32_t row = row_begin; row < row_end; ++row)
+		{
+			for (uint32_t column = column_begin; column < column_end; ++column)
+			{
+				uint64_t key = make_key(level, column, row);
+
+				if (auto it = M_resident.find(key); it != M_resident.end())
+				{
+					M_slots[it->second].last_used = M_frame;
+					continue;
+				}
+
+				if (auto it = M_pending.find(key); it != M_pending.end())
+					it->second->wanted = M_frame;
+				else
+				{
+					double dx = (column + 0.5) * scale - M_center.x;
+					double dy = (row + 0.5) * scale - M_center.y;
+					missing.emplace_back(dx * dx + dy * dy, key);
+				}
+
+				// the tile is drawn from its nearest resident ancestor meanwhile, which has to stay resident
+				for (uint32_t up = level + 1; up < src.levels(); ++up)
+				{
+					auto it = M_resident.find(make_key(up, column >> (up - level), row >> (up - level)));
+					if (it != M_resident.end())
+					{
+						M_slots[it->second].last_used = M_frame;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	// tiles that fell out of view aren't read anymore
+	std::erase_if(M_pending, [this](const auto &cur)
+	{
+		if (cur.first == M_root || cur.second->wanted == M_frame)
+			return false;
+
+		cur.second->cancelled.store(true, std::memory_order_relaxed);
+		return true;
+	});
+
+	// closest to the center of the view first
+	std::sort(missing.begin(), missing.end());
+	for (auto &cur : missing)
+		request_tile(cur.second);
+
+	std::vector<std::shared_ptr<request>> ready;
+	std::function<void()> wake;
+
+	{
+		std::lock_guard lock(M_stream->mutex);
+
+		while (!M_stream->ready.empty() && ready.size() < std::max<std::size_t>(M_upload_budget, 1))
+		{
+			ready.push_back(std::move(M_stream->ready.front()));
+			M_stream->ready.pop_front();
+		}
+
+		// the rest waits for the next frame, which shouldn't wait for input first
+		if (!M_stream->ready.empty())
+			wake = M_stream->ready_callback;
+	}
+
+	// tiles without a free slot stay pending and wait at the front of the queue until one frees up, rather than being read again
+	std::vector<std::shared_ptr<request>> deferred;
+
+	for (auto &cur : ready)
+	{
+		// cancelled after the worker read it
+		auto it = M_pending.find(cur->key);
+		if (it == M_pending.end() || it->second != cur)
+			continue;
+
+		// every slot is drawn this frame, so the tiles after the first one without a slot don't get one either
+		if (!deferred.empty() || !upload_tile(*cur))
+		{
+			deferred.push_back(std::move(cur));
+			continue;
+		}
+
+		M_pending.erase(it);
+	}
+
+	if (!deferred.empty())
+	{
+		std::lock_guard lock(M_stream->mutex);
+		M_stream->ready.insert(M_stream->ready.begin(), std::make_move_iterator(deferred.begin()), std::make_move_iterator(deferred.end()));
+	}
+
+	if (wake)
+		wake();
+
+	if (M_pages_dirty || M_pages_level != level)
+		rebuild_pages(level);
+}
+
+void tiled_image::draw_raw(const window *win, vec2 absolute_min) const
+{
+	if (!win || !M_pages.index())
+		return;
+
+	update();
+
+	auto min = absolute_min + M_min;
+	auto max = min + M_dims;
+
+	{
+		auto &src = source();
+		vec2 half = M_dims / (2 * M_zoom);
+
+		vec2 points[]{ min, { max.x, min.y }, max, { min.x, max.y } };
+		// the bottom of the widget shows the bottom of the view, whose image rows are counted from the top
+		vec2 image_points[]{
+			{ M_center.x - half.x, M_center.y + half.y },
+			{ M_center.x + half.x, M_center.y + half.y },
+			{ M_center.x + half.x, M_center.y - half.y },
+			{ M_center.x - half.x, M_center.y - half.y },
+		};
+
+		M_vbo.attach_data(points, GL_DYNAMIC_DRAW);
+		M_image_vbo.attach_data(image_points, GL_DYNAMIC_DRAW);
+
+		detail::blend_lock lock;
+		detail::cull_face_lock clock;
+		detail::shader_lock slock;
+		detail::vao_lock vlock;
+
+		static auto &program = tiled_image_shader();
+
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDisable(GL_CULL_FACE);
+
+		program.set_uniform("SGUI_Ortho", win->ortho());
+		program.set_uniform("SGUI_Cache", M_cache);
+		program.set_uniform("SGUI_Pages", M_pages);
+		program.set_uniform("SGUI_ImageSize", vec2(static_cast<float>(src.width()), static_cast<float>(src.height())));
+		program.set_uniform("SGUI_TileSize", static_cast<float>(src.tile_size()));
+		program.set_uniform("SGUI_TileStride", static_cast<float>(src.tile_stride()));
+		program.set_uniform("SGUI_CacheSize", static_cast<float>(M_cache.get_width()));
+
+		program.bind();
+
+		M_vao.use();
+		glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+	}
+
+	for (const auto &child : M_children)
+		child->draw_raw(win, min);
+}
+
+void tiled_image::obj_init()
+{
+	auto &src = source();
+
+	GLint max_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+
+	auto columns = static_cast<GLint>(src.columns(0));
+	auto rows = static_cast<GLint>(src.rows(0));
+	auto stride = static_cast<GLint>(src.tile_stride());
+
+	// slots are addressed by a byte in the pages
+	int size = std::min(M_cache_size, static_cast<int>(max_size));
+	M_slots_per_row = static_cast<uint32_t>(std::min(size / stride, 256));
+
+	if (!M_slots_per_row || columns > max_size || rows > max_size)
+	{
+		detail::log_error(error("Tiled image doesn't fit in the cache, or has too many tiles.", error_code::invalid_argument));
+		rectangle::obj_init();
+		return;
+	}
+
+	M_cache.allocate({ .format = GL_RGBA, .min_filter = GL_LINEAR, .mag_filter = GL_LINEAR, .wrap_s = GL_CLAMP_TO_EDGE, .wrap_t = GL_CLAMP_TO_EDGE }, size, size);
+	M_pages.allocate({ .format = GL_RGBA }, columns, rows);
+
+	M_slots.assign(static_cast<std::size_t>(M_slots_per_row) * M_slots_per_row, { no_tile, 0 });
+	M_page_data.assign(static_cast<std::size_t>(columns) * rows * 4, 0);
+	M_pages_dirty = true;
+
+	if (!M_vbo.index())
+		M_vbo.generate();
+	if (!M_image_vbo.index())
+		M_image_vbo.generate();
+	if (!M_vao.index())
+		M_vao = detail::make_shape_vao(M_vbo, &M_image_vbo);
+
+	rectangle::obj_init();
+}
+
+SGUI_END
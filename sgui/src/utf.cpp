@@ -0,0 +1,151 @@
+#include "utils/utf.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SGUI_UTF_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define SGUI_UTF_NEON
+#include <arm_neon.h>
+#endif
+
+SGUI_BEG
+
+DETAIL_BEG
+
+// widens the run of ascii bytes at the start of [in, end) into out, returns the length of the run
+static std::size_t widen_ascii(const char *in, const char *end, uint32_t *out)
+{
+	const char *begin = in;
+
+#if defined(SGUI_UTF_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; end - in >= 16; in += 16, out += 16)
+	{
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+		if (_mm_movemask_epi8(bytes))
+			break;
+
+		__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+		__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4), _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 12), _mm_unpackhi_epi16(hi, zero));
+	}
+#elif defined(SGUI_UTF_NEON)
+	for (; end - in >= 16; in += 16, out += 16)
+	{
+		uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t *>(in));
+		if (vmaxvq_u8(bytes) >= 0x80)
+			break;
+
+		uint16x8_t lo = vmovl_u8(vget_low_u8(bytes));
+		uint16x8_t hi = vmovl_u8(vget_high_u8(bytes));
+
+		vst1q_u32(out, vmovl_u16(vget_low_u16(lo)));
+		vst1q_u32(out + 4, vmovl_u16(vget_high_u16(lo)));
+		vst1q_u32(out + 8, vmovl_u16(vget_low_u16(hi)));
+		vst1q_u32(out + 12, vmovl_u16(vget_high_u16(hi)));
+	}
+#endif
+
+	for (; in != end && static_cast<unsigned char>(*in) < 0x80; ++in, ++out)
+		*out = static_cast<uint32_t>(*in);
+
+	return static_cast<std::size_t>(in - begin);
+}
+
+bool decode_utf8(std::string_view str, std::basic_string<uint32_t> &out)
+{
+	std::size_t offset = out.size();
+
+	// a utf-8 string never has more code points than bytes
+	out.resize(offset + str.size());
+
+	uint32_t *dst = out.data() + offset;
+	const char *it = str.data();
+	const char *end = it + str.size();
+
+	bool valid = true;
+
+	while (it != end)
+	{
+		std::size_t run = widen_ascii(it, end, dst);
+		it += run;
+		dst += run;
+
+		if (it == end)
+			break;
+
+		const char *prev = it;
+		uint32_t c = decode_utf8(it, end);
+
+		// an encoded U+FFFD takes 3 bytes, a malformed sequence only 1
+		if (c == replacement_character && it - prev == 1)
+			valid = false;
+
+		*dst++ = c;
+	}
+
+	out.resize(static_cast<std::size_t>(dst - out.data()));
+
+	return valid;
+}
+
+bool decode_wide(std::wstring_view str, std::basic_string<uint32_t> &out)
+{
+	bool valid = true;
+
+	out.reserve(out.size() + str.size());
+
+	if constexpr (sizeof(wchar_t) == 2)
+	{
+		for (std::size_t i = 0; i < str.size(); ++i)
+		{
+			uint32_t c = static_cast<uint16_t>(str[i]);
+
+			if (c >= 0xD800 && c < 0xDC00 && i + 1 < str.size())
+			{
+				uint32_t low = static_cast<uint16_t>(str[i + 1]);
+				if (low >= 0xDC00 && low < 0xE000)
+				{
+					out.push_back(0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00));
+					++i;
+					continue;
+				}
+			}
+
+			// unpaired surrogate
+			if (c >= 0xD800 && c < 0xE000)
+			{
+				c = replacement_character;
+				valid = false;
+			}
+
+			out.push_back(c);
+		}
+	}
+	else
+	{
+		for (wchar_t w : str)
+		{
+			uint32_t c = static_cast<uint32_t>(w);
+
+			if ((c >= 0xD800 && c < 0xE000) || c > 0x10FFFF)
+			{
+				c = replacement_character;
+				valid = false;
+			}
+
+			out.push_back(c);
+		}
+	}
+
+	return valid;
+}
+
+DETAIL_END
+
+SGUI_END
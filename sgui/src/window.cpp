@@ -3,6 +3,9 @@
 
 #include "gui/widget.h"
 
+#include "graphics/texture_loader.h"
+#include "graphics/residency.h"
+
 #include "utils/error.h"
 #include "utils/context_lock.h"
 
@@ -145,6 +148,10 @@ void window::run()
 		
 		handle_children_input(M_children, {});
 
+		auto &loader = texture_loader::get();
+		loader.upload(loader.get_frame_budget());
+		residency_manager::get().next_frame();
+
 		draw_raw(nullptr, {});
 	}
 }
@@ -170,6 +177,9 @@ void window::create()
 	glfwSetFramebufferSizeCallback(M_window, framebuffer_callback);
 	glfwSetWindowSizeCallback(M_window, windowsize_callback);
 	glfwSetWindowUserPointer(M_window, this);
+
+	// images decoded in the background wake up the event loop, so they're uploaded without waiting for input
+	texture_loader::get().set_ready_callback(glfwPostEmptyEvent);
 }
 
 void mouse_pos_interp(dvec2 window_size, dvec2 target_size, dvec2 &mouse_pos)
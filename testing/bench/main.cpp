@@ -0,0 +1,440 @@
+#include <graphics/pixels.h>
+#include <graphics/resample.h>
+#include <utils/thread_pool.h>
+#include <gui/text.h>
+
+#include <stb_image.h>
+#include <qoi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <cstddef>
+
+using pixel_kernel = void (*)(unsigned char *, const unsigned char *, std::size_t);
+
+// a 2048x2048 image
+static constexpr std::size_t pixel_count = 2048 * 2048;
+
+// best of repeats runs, in milliseconds
+template <typename F>
+static double measure(F &&run, int repeats = 10)
+{
+	double best = 1e30;
+
+	for (int i = 0; i < repeats; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+		run();
+		auto end = std::chrono::steady_clock::now();
+
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	return best;
+}
+
+static void report(const std::string &name, double ms, double baseline)
+{
+	std::cout << "  " << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(3) << std::setw(9) << ms << " ms"
+		<< std::setprecision(2) << std::setw(8) << baseline / ms << "x\n";
+}
+
+// the loops the kernels replace
+
+static void naive_gray_to_rgba(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		dst[4 * i] = dst[4 * i + 1] = dst[4 * i + 2] = src[i];
+		dst[4 * i + 3] = 255;
+	}
+}
+
+static void naive_gray_alpha_to_rgba(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		dst[4 * i] = dst[4 * i + 1] = dst[4 * i + 2] = src[2 * i];
+		dst[4 * i + 3] = src[2 * i + 1];
+	}
+}
+
+static void naive_rgb_to_rgba(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+			dst[4 * i + c] = src[3 * i + c];
+		dst[4 * i + 3] = 255;
+	}
+}
+
+static void naive_swap_red_blue(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		dst[4 * i] = src[4 * i + 2];
+		dst[4 * i + 1] = src[4 * i + 1];
+		dst[4 * i + 2] = src[4 * i];
+		dst[4 * i + 3] = src[4 * i + 3];
+	}
+}
+
+static void naive_premultiply_alpha(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		int a = src[4 * i + 3];
+		for (int c = 0; c < 3; ++c)
+			dst[4 * i + c] = static_cast<unsigned char>((src[4 * i + c] * a + 127) / 255);
+		dst[4 * i + 3] = static_cast<unsigned char>(a);
+	}
+}
+
+static void naive_unpremultiply_alpha(unsigned char *dst, const unsigned char *src, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		int a = src[4 * i + 3];
+		for (int c = 0; c < 3; ++c)
+			dst[4 * i + c] = static_cast<unsigned char>(a ? std::min(255, (src[4 * i + c] * 255 + a / 2) / a) : 0);
+		dst[4 * i + 3] = static_cast<unsigned char>(a);
+	}
+}
+
+static void bench_pixels()
+{
+	struct kernel
+	{
+		const char *name;
+		pixel_kernel naive;
+		pixel_kernel simd;
+	};
+
+	const kernel kernels[] = {
+		{ "gray -> rgba", naive_gray_to_rgba, sgui::detail::gray_to_rgba },
+		{ "gray alpha -> rgba", naive_gray_alpha_to_rgba, sgui::detail::gray_alpha_to_rgba },
+		{ "rgb -> rgba", naive_rgb_to_rgba, sgui::detail::rgb_to_rgba },
+		{ "bgra <-> rgba", naive_swap_red_blue, sgui::detail::swap_red_blue },
+		{ "premultiply", naive_premultiply_alpha, sgui::detail::premultiply_alpha },
+		{ "unpremultiply", naive_unpremultiply_alpha, sgui::detail::unpremultiply_alpha },
+	};
+
+	const std::pair<sgui::detail::simd_level, const char *> levels[] = {
+		{ sgui::detail::simd_level::scalar, "scalar" },
+		{ sgui::detail::simd_level::sse2, "sse2" },
+		{ sgui::detail::simd_level::avx2, "avx2" },
+		{ sgui::detail::simd_level::neon, "neon" },
+	};
+
+	std::vector<unsigned char> src(4 * pixel_count);
+	std::vector<unsigned char> dst(4 * pixel_count);
+
+	std::mt19937 rng(42);
+	for (auto &c : src)
+		c = static_cast<unsigned char>(rng());
+
+	auto best = sgui::detail::get_simd_level();
+
+	std::cout << "pixel conversion, " << pixel_count << " pixels\n";
+
+	for (auto &cur : kernels)
+	{
+		std::cout << cur.name << '\n';
+
+		double baseline = measure([&] { cur.naive(dst.data(), src.data(), pixel_count); });
+		report("naive", baseline, baseline);
+
+		for (auto [level, name] : levels)
+		{
+			sgui::detail::set_simd_level(level);
+			if (sgui::detail::get_simd_level() != level)
+				continue;
+
+			report(name, measure([&] { cur.simd(dst.data(), src.data(), pixel_count); }), baseline);
+		}
+
+		sgui::detail::set_simd_level(best);
+	}
+}
+
+// the 2x2 average convert_texture built mip levels with, one level
+static void naive_halve(const unsigned char *src, int width, int height, unsigned char *dst)
+{
+	int res_width = std::max(width / 2, 1);
+	int res_height = std::max(height / 2, 1);
+
+	for (int y = 0; y < res_height; ++y)
+	{
+		auto *row0 = src + static_cast<std::size_t>(std::min(2 * y, height - 1)) * width * 4;
+		auto *row1 = src + static_cast<std::size_t>(std::min(2 * y + 1, height - 1)) * width * 4;
+
+		for (int x = 0; x < res_width; ++x)
+		{
+			int x0 = std::min(2 * x, width - 1) * 4;
+			int x1 = std::min(2 * x + 1, width - 1) * 4;
+
+			for (int c = 0; c < 4; ++c)
+				*dst++ = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+		}
+	}
+}
+
+static void bench_resample()
+{
+	const std::pair<sgui::detail::simd_level, const char *> levels[] = {
+		{ sgui::detail::simd_level::scalar, "scalar" },
+		{ sgui::detail::simd_level::sse2, "sse2" },
+		{ sgui::detail::simd_level::avx2, "avx2" },
+		{ sgui::detail::simd_level::neon, "neon" },
+	};
+
+	std::vector<unsigned char> src(4 * pixel_count);
+
+	std::mt19937 rng(42);
+	for (auto &c : src)
+		c = static_cast<unsigned char>(rng());
+
+	auto best = sgui::detail::get_simd_level();
+	sgui::thread_pool pool;
+
+	std::cout << "downscaling, 2048x2048 rgba, " << pool.size() << " workers in the pool\n";
+
+	std::cout << "box mip chain\n";
+
+	double baseline = measure([&]
+	{
+		std::vector<unsigned char> prev(src), next;
+		for (int size = 2048; size > 1; size /= 2)
+		{
+			next.resize(static_cast<std::size_t>(size / 2) * (size / 2) * 4);
+			naive_halve(prev.data(), size, size, next.data());
+			prev.swap(next);
+		}
+	});
+	report("naive", baseline, baseline);
+
+	for (auto [level, name] : levels)
+	{
+		sgui::detail::set_simd_level(level);
+		if (sgui::detail::get_simd_level() != level)
+			continue;
+
+		report(name, measure([&] { sgui::build_mip_chain(src.data(), 2048, 2048, 4); }), baseline);
+	}
+
+	sgui::detail::set_simd_level(best);
+	report("pool", measure([&] { sgui::build_mip_chain(src.data(), 2048, 2048, 4, sgui::resample_filter::box, &pool); }), baseline);
+
+	std::vector<unsigned char> dst(512 * 512 * 4);
+
+	for (auto [filter, filter_name] : { std::pair{ sgui::resample_filter::box, "box" }, std::pair{ sgui::resample_filter::lanczos3, "lanczos3" } })
+	{
+		std::cout << filter_name << " to 512x512\n";
+
+		auto run = [&, filter = filter](sgui::thread_pool *threads) { sgui::resample_image(src.data(), 2048, 2048, dst.data(), 512, 512, 4, filter, threads); };
+
+		sgui::detail::set_simd_level(sgui::detail::simd_level::scalar);
+		baseline = measure([&] { run(nullptr); });
+
+		for (auto [level, name] : levels)
+		{
+			sgui::detail::set_simd_level(level);
+			if (sgui::detail::get_simd_level() != level)
+				continue;
+
+			report(name, level == sgui::detail::simd_level::scalar ? baseline : measure([&] { run(nullptr); }), baseline);
+		}
+
+		sgui::detail::set_simd_level(best);
+		report("pool", measure([&] { run(&pool); }), baseline);
+	}
+}
+
+static std::vector<unsigned char> read_file(const std::filesystem::path &file_name)
+{
+	std::ifstream in(file_name, std::ios::binary);
+	return { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+}
+
+// decodes the image with stb_image like texture::load does, then the same pixels encoded as qoi. An encoding shipped along with the image
+// (qoi_file, written by another encoder) is decoded instead, and has to give the same pixels. Returns false if it doesn't
+static bool bench_qoi_image(const std::string &name, const std::vector<unsigned char> &file, const std::vector<unsigned char> &qoi_file)
+{
+	int width, height, channels;
+	if (!stbi_info_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels))
+		return true;
+
+	// qoi only stores rgb and rgba
+	int qoi_channels = channels == 1 || channels == 3 ? 3 : 4;
+	unsigned char *pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels, qoi_channels);
+	if (!pixels)
+		return true;
+
+	std::size_t size = static_cast<std::size_t>(width) * height * qoi_channels;
+	bool matches = true;
+	int encoded_size = 0;
+	void *encoded = nullptr;
+
+	if (qoi_file.empty())
+	{
+		qoi_desc desc{ static_cast<unsigned int>(width), static_cast<unsigned int>(height), static_cast<unsigned char>(qoi_channels), QOI_SRGB };
+		encoded = qoi_encode(pixels, &desc, &encoded_size);
+	}
+	else
+	{
+		encoded_size = static_cast<int>(qoi_file.size());
+
+		qoi_desc res;
+		auto *decoded = static_cast<unsigned char *>(qoi_decode(qoi_file.data(), encoded_size, &res, qoi_channels));
+		matches = decoded && static_cast<int>(res.width) == width && static_cast<int>(res.height) == height && std::equal(pixels, pixels + size, decoded);
+		qoi_free(decoded);
+	}
+
+	stbi_image_free(pixels);
+
+	const void *data = qoi_file.empty() ? encoded : qoi_file.data();
+	if (!data)
+		return true;
+
+	std::cout << name << ", " << width << 'x' << height << ", " << file.size() << " bytes, " << encoded_size << (qoi_file.empty() ? " as qoi\n" : " as its qoi file\n");
+
+	if (!matches)
+		std::cout << "  the qoi file doesn't decode to the image\n";
+
+	double baseline = measure([&]
+	{
+		int w, h, ch;
+		stbi_image_free(stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &w, &h, &ch, 0));
+	});
+	report("stb_image", baseline, baseline);
+
+	report("qoi", measure([&]
+	{
+		qoi_desc res;
+		qoi_free(qoi_decode(data, encoded_size, &res, 0));
+	}), baseline);
+
+	qoi_free(encoded);
+	return matches;
+}
+
+// returns false if an image's qoi file doesn't decode to it
+static bool bench_qoi(const std::vector<std::string> &files)
+{
+	std::vector<std::filesystem::path> images(files.begin(), files.end());
+
+	// the images among the assets, unless some are given
+	std::error_code ec;
+	if (images.empty())
+		for (auto &entry : std::filesystem::directory_iterator(SGUI_ASSETS_DIR, ec))
+			if (entry.is_regular_file())
+				images.push_back(entry.path());
+
+	std::cout << "image decoding\n";
+
+	bool res = true;
+	std::size_t benched = 0;
+	for (auto &cur : images)
+	{
+		auto file = read_file(cur);
+
+		// qoi files are decoded along with the image of the same name
+		int width, height, channels;
+		if (file.empty() || !stbi_info_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels))
+			continue;
+
+		std::vector<unsigned char> qoi_file;
+		if (auto qoi_name = std::filesystem::path(cur).replace_extension(".qoi"); qoi_name != cur && std::filesystem::is_regular_file(qoi_name, ec))
+			qoi_file = read_file(qoi_name);
+
+		res = bench_qoi_image(cur.filename().string(), file, qoi_file) && res;
+		++benched;
+	}
+
+	if (!benched)
+		std::cout << "  no images among the assets, pass image files to compare qoi with stb_image on them\n";
+
+	// noise over gradients, which mixes qoi's difference chunks unpredictably, so qoi is measured even without any image
+	std::vector<unsigned char> pixels(4 * pixel_count);
+	std::mt19937 rng(42);
+
+	for (std::size_t i = 0; i < pixel_count; ++i)
+	{
+		std::size_t x = i % 2048, y = i / 2048;
+		pixels[4 * i] = static_cast<unsigned char>(x / 8 + rng() % 4);
+		pixels[4 * i + 1] = static_cast<unsigned char>(y / 8 + rng() % 4);
+		pixels[4 * i + 2] = static_cast<unsigned char>((x + y) / 16);
+		pixels[4 * i + 3] = 255;
+	}
+
+	qoi_desc desc{ 2048, 2048, 4, QOI_SRGB };
+	int encoded_size = 0;
+	void *encoded = nullptr;
+
+	double encode = measure([&]
+	{
+		qoi_free(encoded);
+		encoded = qoi_encode(pixels.data(), &desc, &encoded_size);
+	});
+	double decode = measure([&]
+	{
+		qoi_desc res;
+		qoi_free(qoi_decode(encoded, encoded_size, &res, 0));
+	});
+
+	std::cout << "generated, 2048x2048, " << encoded_size << " bytes as qoi\n";
+	report("encode", encode, encode);
+	report("decode", decode, encode);
+
+	qoi_free(encoded);
+	return res;
+}
+
+// a text laid out before its font gets a fallback has to take the fallback's advances, like a text made after it.
+// Lato has no cyrillic, arial has. Returns false if it doesn't
+static bool check_fallback_layout()
+{
+	std::cout << "text layout\n";
+
+	sgui::font lato(SGUI_ASSETS_DIR "/Lato-Regular.ttf", 32);
+	sgui::font arial(SGUI_ASSETS_DIR "/arial.ttf", 32);
+
+	// "Жук"
+	static constexpr std::string_view str = "\xd0\x96\xd1\x83\xd0\xba";
+
+	auto before = sgui::text::make(str, lato);
+	float missing = before->get_local_rect().dims.x;
+
+	lato.add_fallback(arial);
+	float laid_out = before->get_local_rect().dims.x;
+	float fresh = sgui::text::make(str, lato)->get_local_rect().dims.x;
+
+	lato.clear_fallbacks();
+	float cleared = before->get_local_rect().dims.x;
+
+	std::cout << "  fallback " << fresh << " wide, " << laid_out << " laid out before it, " << cleared << " once cleared (" << missing << " before)\n";
+
+	bool res = laid_out == fresh && cleared == missing;
+	if (!res)
+		std::cout << "  the text kept the metrics it was laid out with\n";
+
+	return res;
+}
+
+int main(int argc, char **argv)
+{
+	bench_pixels();
+	bench_resample();
+	bool res = bench_qoi({ argv + 1, argv + argc });
+	res = check_fallback_layout() && res;
+	return res ? 0 : 1;
+}